@@ -0,0 +1,64 @@
+#include "atomic_file.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+
+bool syncStream(FILE* f) { return _commit(_fileno(f)) == 0; }
+
+// Write-through, so the rename is on disk when this returns; Windows has
+// no directory handle to sync.
+bool replaceAndSync(const std::string& from, const std::string& to) {
+    return MoveFileExA(from.c_str(), to.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+#else
+
+bool syncStream(FILE* f) { return fsync(fileno(f)) == 0; }
+
+bool syncDirectory(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool replaceAndSync(const std::string& from, const std::string& to) {
+    return std::rename(from.c_str(), to.c_str()) == 0 && syncDirectory(to);
+}
+
+#endif
+
+}
+
+bool writeFileAtomically(const std::string& path, const void* data, size_t length) {
+    std::string tmp = path + ".tmp";
+    FILE* out = std::fopen(tmp.c_str(), "wb");
+    if (!out) return false;
+
+    // Synced before the rename, so the name never points at a file whose
+    // contents are still in the page cache.
+    bool ok = std::fwrite(data, 1, length, out) == length;
+    ok = std::fflush(out) == 0 && ok;
+    ok = syncStream(out) && ok;
+    ok = std::fclose(out) == 0 && ok;
+
+    if (!ok || !replaceAndSync(tmp, path)) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
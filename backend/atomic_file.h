@@ -0,0 +1,15 @@
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Replaces path with data: written to path + ".tmp" and synced, renamed
+// over path in one step (rename(), or MoveFileEx on Windows), then the
+// directory is synced so the new name survives a crash. At every point
+// path holds either the old contents or the new. False if any step fails;
+// the temp file is removed and path is left as it was, unless only the
+// final directory sync failed.
+bool writeFileAtomically(const std::string& path, const void* data, size_t length);
+
+#endif
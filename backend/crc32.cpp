@@ -0,0 +1,28 @@
+#include "crc32.h"
+
+namespace {
+
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+}
+
+uint32_t crc32(const void* data, size_t length, uint32_t crc) {
+    static const CrcTable table;
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = table.entries[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
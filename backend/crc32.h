@@ -0,0 +1,10 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstdint>
+#include <cstddef>
+
+// CRC-32 (IEEE 802.3), continuing from a previous value.
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+#endif
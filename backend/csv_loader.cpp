@@ -0,0 +1,184 @@
+#include "csv_loader.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include <algorithm>
+#include <filesystem>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Below this many bytes per thread, spawning costs more than it saves.
+const size_t MIN_CHUNK_BYTES = 1 << 18;
+
+// Bit i of quotes / newlines is set where p[i] is '"' / '\n'.
+inline void scanBlock(const char* p, uint32_t& quotes, uint32_t& newlines) {
+#ifdef __SSE2__
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+#else
+    quotes = newlines = 0;
+    for (int i = 0; i < 16; i++) {
+        quotes |= uint32_t(p[i] == '"') << i;
+        newlines |= uint32_t(p[i] == '\n') << i;
+    }
+#endif
+}
+
+size_t countQuotes(const char* p, size_t n) {
+    size_t count = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint32_t quotes, newlines;
+        scanBlock(p + i, quotes, newlines);
+        count += __builtin_popcount(quotes);
+    }
+    for (; i < n; i++)
+        count += p[i] == '"';
+    return count;
+}
+
+// Appends base + offset one past every newline in p[0, n) that lies outside
+// quotes, given whether p[0] starts inside a quoted field. A doubled quote
+// toggles twice, so escapes need no special case here.
+void findRecordEnds(const char* p, size_t n, bool inQuotes, size_t base,
+                    std::vector<size_t>& ends) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint32_t quotes, newlines;
+        scanBlock(p + i, quotes, newlines);
+
+        if (!quotes) {
+            if (inQuotes) continue;
+            for (; newlines; newlines &= newlines - 1)
+                ends.push_back(base + i + __builtin_ctz(newlines) + 1);
+            continue;
+        }
+
+        for (uint32_t events = quotes | newlines; events; events &= events - 1) {
+            int bit = __builtin_ctz(events);
+            if (quotes & (1u << bit)) inQuotes = !inQuotes;
+            else if (!inQuotes) ends.push_back(base + i + bit + 1);
+        }
+    }
+    for (; i < n; i++) {
+        if (p[i] == '"') inQuotes = !inQuotes;
+        else if (p[i] == '\n' && !inQuotes) ends.push_back(base + i + 1);
+    }
+}
+
+Book* parseBookRecord(const char* begin, const char* end, std::vector<std::string>& fields) {
+    if (end > begin && end[-1] == '\r') --end;
+
+    fields.clear();
+    splitCSVRecord(begin, end, fields);
+    if (fields.size() < 5) return nullptr;
+
+    ISBN isbn;
+    if (!ISBN::parse(fields[0], isbn)) return nullptr;
+
+    int copies = 1;
+    try { copies = std::stoi(fields[4]); }
+    catch (...) {}
+
+    return new Book(isbn, fields[1], fields[2], fields[3], copies);
+}
+
+}
+
+void splitCSVRecord(const char* p, const char* end, std::vector<std::string>& fields) {
+    std::string current;
+    bool inQuotes = false;
+    const char* run = p;     // start of the literal bytes not yet copied
+
+    while (p < end) {
+        if (inQuotes) {
+            if (*p != '"') { ++p; continue; }
+            current.append(run, p);
+            if (p + 1 < end && p[1] == '"') {
+                current += '"';
+                p += 2;
+            } else {
+                inQuotes = false;
+                ++p;
+            }
+            run = p;
+        } else if (*p == '"') {
+            current.append(run, p);
+            inQuotes = true;
+            run = ++p;
+        } else if (*p == ',') {
+            current.append(run, p);
+            fields.push_back(current);
+            current.clear();
+            run = ++p;
+        } else {
+            ++p;
+        }
+    }
+    current.append(run, p);
+    fields.push_back(current);
+}
+
+std::vector<Book*> readBooksCSV(const std::string& path, unsigned threads) {
+    std::vector<Book*> books;
+
+    std::error_code ec;
+    uintmax_t fileSize = std::filesystem::file_size(path, ec);
+    if (ec || fileSize == 0) return books;
+
+    MappedFile file(path);
+    const char* data = reinterpret_cast<const char*>(file.data());
+    const size_t size = file.size();
+
+    threads = std::max<size_t>(1, std::min<size_t>(resolveThreads(threads), size / MIN_CHUNK_BYTES));
+
+    // Pass 1: quote parity of each chunk, so every chunk knows whether it
+    // starts inside a quoted field.
+    std::vector<size_t> chunkStart(threads + 1);
+    for (unsigned t = 0; t <= threads; t++)
+        chunkStart[t] = size * t / threads;
+
+    std::vector<size_t> quoteCount(threads);
+    runParallel(threads, [&](unsigned t) {
+        quoteCount[t] = countQuotes(data + chunkStart[t], chunkStart[t + 1] - chunkStart[t]);
+    });
+
+    // Pass 2: record boundaries within each chunk.
+    std::vector<std::vector<size_t>> chunkEnds(threads);
+    std::vector<bool> startsQuoted(threads, false);
+    for (unsigned t = 1; t < threads; t++)
+        startsQuoted[t] = startsQuoted[t - 1] != (quoteCount[t - 1] % 2 == 1);
+
+    runParallel(threads, [&](unsigned t) {
+        findRecordEnds(data + chunkStart[t], chunkStart[t + 1] - chunkStart[t],
+                       startsQuoted[t], chunkStart[t], chunkEnds[t]);
+    });
+
+    std::vector<size_t> bounds(1, 0);
+    for (const auto& ends : chunkEnds)
+        bounds.insert(bounds.end(), ends.begin(), ends.end());
+    if (bounds.back() != size) bounds.push_back(size);
+
+    // Pass 3: parse records 1.. (0 is the header) in contiguous slices.
+    size_t records = bounds.size() - 1;
+    std::vector<std::vector<Book*>> parsed(threads);
+    runParallel(threads, [&](unsigned t) {
+        size_t first = 1 + (records - 1) * t / threads;
+        size_t last = 1 + (records - 1) * (t + 1) / threads;
+        std::vector<std::string> fields;
+
+        for (size_t r = first; r < last; r++) {
+            size_t end = bounds[r + 1];
+            if (data[end - 1] == '\n') --end;
+            Book* book = parseBookRecord(data + bounds[r], data + end, fields);
+            if (book) parsed[t].push_back(book);
+        }
+    });
+
+    for (auto& part : parsed)
+        books.insert(books.end(), part.begin(), part.end());
+    return books;
+}
@@ -0,0 +1,27 @@
+#ifndef CSV_LOADER_H
+#define CSV_LOADER_H
+
+#include "models.h"
+#include <string>
+#include <vector>
+
+/*
+ * Bulk loader for books.csv (ISBN,Title,Author,Category,Copies after a
+ * header row). The file is mapped rather than read, record boundaries are
+ * found by scanning 16 bytes at a time for quotes and newlines, and the
+ * records are parsed into Books on several threads.
+ *
+ * Fields follow RFC 4180: a quoted field may contain commas, newlines and
+ * doubled quotes (""), and a \r before the record's newline is dropped.
+ */
+
+// Splits one record (without its line terminator), appending the fields.
+void splitCSVRecord(const char* begin, const char* end, std::vector<std::string>& fields);
+
+// Books in file order. Records with fewer than five fields or an ISBN that
+// does not parse are skipped, and an unreadable copy count becomes 1.
+// threads == 0 uses one per core; small files are parsed on the calling
+// thread. A missing or empty file yields no books.
+std::vector<Book*> readBooksCSV(const std::string& path, unsigned threads = 0);
+
+#endif
@@ -0,0 +1,265 @@
+#include "inverted_index.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <map>
+
+static const double BM25_K1 = 1.2;
+static const double BM25_B = 0.75;
+static const double FIELD_WEIGHTS[] = { 2.0, 1.5, 0.5 };   // title, author, category
+static const double IMPACT_WEIGHT = 0.5;
+
+InvertedIndex::InvertedIndex(const std::vector<Book*>& docTable)
+    : docs(docTable), docCount(0), maxBorrowImpact(0), boundsDirty(false) {
+    for (int f = 0; f < NUM_FIELDS; f++) totalLength[f] = 0;
+}
+
+std::vector<std::string> InvertedIndex::tokenize(const std::string& text) {
+    std::vector<std::string> tokens;
+    std::string curr;
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (std::isalnum(u)) {
+            curr += static_cast<char>(std::tolower(u));
+        } else if (!curr.empty()) {
+            tokens.push_back(curr);
+            curr.clear();
+        }
+    }
+    if (!curr.empty()) tokens.push_back(curr);
+    return tokens;
+}
+
+/* ================= BUILD ================= */
+
+void InvertedIndex::addDocument(uint32_t docID) {
+    const Book* b = docs[docID];
+    const std::string* fields[NUM_FIELDS] = { &b->title, &b->author, &b->category };
+
+    if (docLengths.size() <= docID) docLengths.resize(docID + 1);
+    docLengths[docID].assign(NUM_FIELDS, 0);
+
+    std::map<std::string, Posting> counts;
+    for (int f = 0; f < NUM_FIELDS; f++) {
+        for (const auto& tok : tokenize(*fields[f])) {
+            auto it = counts.find(tok);
+            if (it == counts.end())
+                it = counts.emplace(tok, Posting{ docID, { 0, 0, 0 } }).first;
+            if (it->second.tf[f] < 255) it->second.tf[f]++;
+            docLengths[docID][f]++;
+        }
+        totalLength[f] += docLengths[docID][f];
+    }
+
+    for (auto& c : counts) {
+        auto it = termIDs.find(c.first);
+        if (it == termIDs.end()) {
+            it = termIDs.emplace(c.first, terms.size()).first;
+            terms.emplace_back();
+        }
+
+        auto& list = terms[it->second].postings;
+        if (list.empty() || list.back().docID < docID) {
+            list.push_back(c.second);
+        } else {
+            auto pos = std::lower_bound(list.begin(), list.end(), docID,
+                [](const Posting& p, uint32_t id) { return p.docID < id; });
+            list.insert(pos, c.second);
+        }
+    }
+
+    docCount++;
+    maxBorrowImpact = std::max(maxBorrowImpact, b->borrowImpact);
+    boundsDirty = true;
+}
+
+void InvertedIndex::removeDocument(uint32_t docID) {
+    const Book* b = docs[docID];
+    const std::string* fields[NUM_FIELDS] = { &b->title, &b->author, &b->category };
+
+    std::vector<std::string> tokens;
+    for (int f = 0; f < NUM_FIELDS; f++) {
+        for (const auto& tok : tokenize(*fields[f])) tokens.push_back(tok);
+        totalLength[f] -= docLengths[docID][f];
+    }
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+
+    for (const auto& tok : tokens) {
+        auto it = termIDs.find(tok);
+        if (it == termIDs.end()) continue;
+
+        auto& list = terms[it->second].postings;
+        auto pos = std::lower_bound(list.begin(), list.end(), docID,
+            [](const Posting& p, uint32_t id) { return p.docID < id; });
+        if (pos != list.end() && pos->docID == docID) list.erase(pos);
+    }
+
+    docLengths[docID].assign(NUM_FIELDS, 0);
+    docCount--;
+    boundsDirty = true;
+}
+
+void InvertedIndex::updateBorrowImpact(uint32_t docID) {
+    maxBorrowImpact = std::max(maxBorrowImpact, docs[docID]->borrowImpact);
+}
+
+/* ================= SCORING ================= */
+
+double InvertedIndex::idf(const TermPostings& t) const {
+    double df = t.postings.size();
+    return std::log(1.0 + (docCount - df + 0.5) / (df + 0.5));
+}
+
+double InvertedIndex::fieldScore(const TermPostings& t, const Posting& p, int field) const {
+    double tf = p.tf[field];
+    if (tf == 0) return 0;
+
+    double avg = docCount ? totalLength[field] / docCount : 0;
+    if (avg <= 0) avg = 1;
+    double len = docLengths[p.docID][field];
+
+    double norm = tf + BM25_K1 * (1 - BM25_B + BM25_B * len / avg);
+    return FIELD_WEIGHTS[field] * idf(t) * tf * (BM25_K1 + 1) / norm;
+}
+
+double InvertedIndex::termScore(const TermPostings& t, const Posting& p, unsigned fields) const {
+    double s = 0;
+    for (int f = 0; f < NUM_FIELDS; f++)
+        if (fields & (1u << f)) s += fieldScore(t, p, f);
+    return s;
+}
+
+double InvertedIndex::prior(uint32_t docID) const {
+    return IMPACT_WEIGHT * std::log1p(static_cast<double>(std::max(0LL, docs[docID]->borrowImpact)));
+}
+
+// idf and average lengths move with every added document, so the per-term
+// bounds are recomputed lazily before the next query.
+void InvertedIndex::refreshBounds() {
+    for (auto& t : terms) {
+        for (int f = 0; f < NUM_FIELDS; f++) t.maxFieldScore[f] = 0;
+        for (const auto& p : t.postings)
+            for (int f = 0; f < NUM_FIELDS; f++)
+                t.maxFieldScore[f] = std::max(t.maxFieldScore[f], fieldScore(t, p, f));
+    }
+    boundsDirty = false;
+}
+
+/* ================= QUERY (MaxScore) ================= */
+
+std::vector<ScoredDoc> InvertedIndex::search(
+    const std::string& query, unsigned fields, size_t limit,
+    const ScoredDoc* after
+) {
+    if (boundsDirty) refreshBounds();
+
+    struct Cursor {
+        const TermPostings* term;
+        size_t pos;
+        double bound;
+    };
+
+    std::vector<std::string> tokens = tokenize(query);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+
+    std::vector<Cursor> cursors;
+    for (const auto& tok : tokens) {
+        auto it = termIDs.find(tok);
+        if (it == termIDs.end()) continue;
+
+        const TermPostings& t = terms[it->second];
+        double bound = 0;
+        for (int f = 0; f < NUM_FIELDS; f++)
+            if (fields & (1u << f)) bound += t.maxFieldScore[f];
+        cursors.push_back({ &t, 0, bound });
+    }
+    if (cursors.empty()) return {};
+
+    std::sort(cursors.begin(), cursors.end(),
+        [](const Cursor& a, const Cursor& b) { return a.bound < b.bound; });
+
+    // cumBound[i]: the most terms 0..i can add together
+    std::vector<double> cumBound(cursors.size());
+    double running = 0;
+    for (size_t i = 0; i < cursors.size(); i++) {
+        running += cursors[i].bound;
+        cumBound[i] = running;
+    }
+
+    const double priorBound = IMPACT_WEIGHT * std::log1p(static_cast<double>(std::max(0LL, maxBorrowImpact)));
+    const size_t k = limit ? limit : docCount;
+
+    // Min-heap on rankedBefore: front() is the current K-th best.
+    std::vector<ScoredDoc> heap;
+    double threshold = -std::numeric_limits<double>::infinity();
+    size_t firstEssential = 0;
+
+    while (firstEssential < cursors.size()) {
+        uint32_t d = std::numeric_limits<uint32_t>::max();
+        for (size_t i = firstEssential; i < cursors.size(); i++) {
+            const Cursor& c = cursors[i];
+            if (c.pos < c.term->postings.size())
+                d = std::min(d, c.term->postings[c.pos].docID);
+        }
+        if (d == std::numeric_limits<uint32_t>::max()) break;
+
+        double score = 0;
+        bool matched = false;
+        for (size_t i = firstEssential; i < cursors.size(); i++) {
+            Cursor& c = cursors[i];
+            if (c.pos < c.term->postings.size() && c.term->postings[c.pos].docID == d) {
+                double s = termScore(*c.term, c.term->postings[c.pos], fields);
+                if (s > 0) { score += s; matched = true; }
+                c.pos++;
+            }
+        }
+        if (!matched) continue;
+
+        score += prior(d);
+
+        // Non-essential terms, largest bound first, only while they can
+        // still lift the document over the threshold.
+        bool pruned = false;
+        for (size_t i = firstEssential; i-- > 0;) {
+            if (score + cumBound[i] <= threshold) {
+                pruned = true;
+                break;
+            }
+            Cursor& c = cursors[i];
+            const auto& list = c.term->postings;
+            auto it = std::lower_bound(list.begin() + c.pos, list.end(), d,
+                [](const Posting& p, uint32_t id) { return p.docID < id; });
+            c.pos = it - list.begin();
+            if (it != list.end() && it->docID == d)
+                score += termScore(*c.term, *it, fields);
+        }
+        if (pruned) continue;
+
+        ScoredDoc doc{ d, score };
+        if (after && !rankedBefore(*after, doc)) continue;
+
+        if (heap.size() < k) {
+            heap.push_back(doc);
+            std::push_heap(heap.begin(), heap.end(), rankedBefore);
+        } else if (score > threshold) {
+            std::pop_heap(heap.begin(), heap.end(), rankedBefore);
+            heap.back() = doc;
+            std::push_heap(heap.begin(), heap.end(), rankedBefore);
+        } else {
+            continue;
+        }
+
+        if (heap.size() == k) {
+            threshold = heap.front().score;
+            while (firstEssential < cursors.size() &&
+                   cumBound[firstEssential] + priorBound <= threshold)
+                firstEssential++;
+        }
+    }
+
+    std::sort(heap.begin(), heap.end(), rankedBefore);
+    return heap;
+}
@@ -0,0 +1,77 @@
+#ifndef INVERTED_INDEX_H
+#define INVERTED_INDEX_H
+
+#include "models.h"
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Field bits for InvertedIndex::search
+const unsigned FIELD_TITLE = 1;
+const unsigned FIELD_AUTHOR = 2;
+const unsigned FIELD_CATEGORY = 4;
+const unsigned FIELD_ALL = FIELD_TITLE | FIELD_AUTHOR | FIELD_CATEGORY;
+
+/*
+ * Term -> document inverted index with per-field statistics, scored with
+ * field-weighted BM25 plus a log(borrowImpact) popularity prior.
+ *
+ * Top-K queries use MaxScore: terms are ordered by their score upper bound
+ * and, once the K-th best score exceeds what the cheapest terms could add
+ * together, documents that only appear in those terms are never scored.
+ */
+class InvertedIndex {
+private:
+    static const int NUM_FIELDS = 3;
+
+    struct Posting {
+        uint32_t docID;
+        uint8_t tf[NUM_FIELDS];
+    };
+
+    struct TermPostings {
+        std::vector<Posting> postings;          // ascending docID
+        double maxFieldScore[NUM_FIELDS];       // upper bound per field
+    };
+
+    const std::vector<Book*>& docs;
+
+    std::unordered_map<std::string, uint32_t> termIDs;
+    std::vector<TermPostings> terms;
+
+    std::vector<std::vector<uint16_t>> docLengths;   // [docID][field]
+    double totalLength[NUM_FIELDS];
+    uint32_t docCount;
+    long long maxBorrowImpact;
+    bool boundsDirty;
+
+    double idf(const TermPostings& t) const;
+    double fieldScore(const TermPostings& t, const Posting& p, int field) const;
+    double termScore(const TermPostings& t, const Posting& p, unsigned fields) const;
+    double prior(uint32_t docID) const;
+    void refreshBounds();
+
+public:
+    explicit InvertedIndex(const std::vector<Book*>& docTable);
+
+    static std::vector<std::string> tokenize(const std::string& text);
+
+    void addDocument(uint32_t docID);
+
+    // Must run while the book still holds the text it was indexed with.
+    void removeDocument(uint32_t docID);
+
+    // Keeps the popularity-prior upper bound in step with circulation.
+    void updateBorrowImpact(uint32_t docID);
+
+    // Best `limit` documents (all matches when limit == 0) in rankedBefore
+    // order. With `after`, only documents ranked strictly after it count,
+    // which is how a results page is continued.
+    std::vector<ScoredDoc> search(
+        const std::string& query, unsigned fields, size_t limit,
+        const ScoredDoc* after = nullptr
+    );
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "isbn.h"
+
+namespace {
+
+const unsigned HYPHEN_SHIFT = ISBN::ID_BITS;
+const unsigned TEN_BIT = 56;
+const unsigned CHECK10_SHIFT = 57;
+
+// Check digit of the ISBN-13 whose first twelve digits are body.
+unsigned check13(uint64_t body) {
+    unsigned sum = 0;
+    for (int i = 11; i >= 0; i--, body /= 10)
+        sum += (body % 10) * (i % 2 ? 3 : 1);
+    return (10 - sum % 10) % 10;
+}
+
+// Check value (10 for X) of the ISBN-10 whose first nine digits are body.
+unsigned check10(uint64_t body) {
+    unsigned sum = 0;
+    for (int weight = 2; weight <= 10; weight++, body /= 10)
+        sum += (body % 10) * weight;
+    return (11 - sum % 11) % 11;
+}
+
+uint64_t pow10(unsigned n) {
+    uint64_t p = 1;
+    while (n--) p *= 10;
+    return p;
+}
+
+}
+
+bool ISBN::parse(const std::string& text, ISBN& out) {
+    uint64_t digits = 0;
+    uint64_t hyphens = 0;
+    unsigned count = 0;
+    int check = -1;                 // an ISBN-10's final X
+
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c >= '0' && c <= '9' && check < 0) {
+            digits = digits * 10 + (c - '0');
+            if (++count > 13) return false;
+        } else if ((c == 'X' || c == 'x') && count == 9 && check < 0) {
+            check = 10;
+        } else if (c == '-' && count > 0 && count < 13 && i + 1 < text.size() &&
+                   text[i - 1] != '-' && check < 0) {
+            hyphens |= 1ULL << (count - 1);
+        } else {
+            return false;
+        }
+    }
+
+    if (count == 13 && check < 0) {
+        uint64_t prefix = digits / 10000000000ULL;
+        if (prefix != 978 && prefix != 979) return false;
+        out.packed = digits | hyphens << HYPHEN_SHIFT;
+        return true;
+    }
+
+    if (count == 10 || (count == 9 && check == 10)) {
+        uint64_t body = count == 10 ? digits / 10 : digits;
+        if (check < 0) check = static_cast<int>(digits % 10);
+        // The number keeps only the body, so a wrong check digit would
+        // make this the same book as the right one.
+        if (static_cast<unsigned>(check) != check10(body)) return false;
+
+        uint64_t body13 = 978000000000ULL + body;
+        out.packed = (body13 * 10 + check13(body13)) | hyphens << HYPHEN_SHIFT |
+                     1ULL << TEN_BIT | static_cast<uint64_t>(check) << CHECK10_SHIFT;
+        return true;
+    }
+    return false;
+}
+
+bool ISBN::prefixRange(const std::string& prefix, uint64_t& first, uint64_t& last) {
+    uint64_t digits = 0;
+    unsigned count = 0;
+    for (char c : prefix) {
+        if (c == '-') continue;
+        if (c < '0' || c > '9' || ++count > 13) return false;
+        digits = digits * 10 + (c - '0');
+    }
+
+    // Shorter than the EAN prefix: "9" and "97" are read as ISBN-13
+    // prefixes, and since every ISBN is stored as 978 or 979 they match
+    // them all, like an empty prefix.
+    bool thirteen = count < 3 ? 978 / pow10(3 - count) == digits
+                              : digits / pow10(count - 3) == 978 ||
+                                digits / pow10(count - 3) == 979;
+    if (!thirteen) {
+        if (count > 9) return false;
+        digits += 978 * pow10(count);
+        count += 3;
+    }
+
+    first = digits * pow10(13 - count);
+    last = (digits + 1) * pow10(13 - count);
+    return true;
+}
+
+std::string ISBN::str() const {
+    if (empty()) return "";
+
+    bool ten = (packed >> TEN_BIT) & 1;
+    char digits[14];
+    unsigned count = ten ? 10 : 13;
+    uint64_t n = ten ? id() / 10 % 1000000000ULL : id();
+
+    if (ten) {
+        unsigned check = (packed >> CHECK10_SHIFT) & 15;
+        digits[9] = check == 10 ? 'X' : static_cast<char>('0' + check);
+    }
+    for (int i = static_cast<int>(ten ? 8 : 12); i >= 0; i--, n /= 10)
+        digits[i] = static_cast<char>('0' + n % 10);
+
+    std::string out;
+    out.reserve(17);
+    uint64_t hyphens = packed >> HYPHEN_SHIFT;
+    for (unsigned i = 0; i < count; i++) {
+        out += digits[i];
+        if (i + 1 < count && (hyphens >> i) & 1) out += '-';
+    }
+    return out;
+}
+
+bool ISBN::checksumValid() const {
+    if (empty()) return false;
+    if ((packed >> TEN_BIT) & 1)
+        return ((packed >> CHECK10_SHIFT) & 15) == check10(id() / 10 % 1000000000ULL);
+    return id() % 10 == check13(id() / 10);
+}
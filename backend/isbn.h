@@ -0,0 +1,65 @@
+#ifndef ISBN_H
+#define ISBN_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+/*
+ * An ISBN packed into 64 bits. The low 44 bits hold the ISBN-13 number
+ * (an ISBN-10 is converted: 978 prefix, ISBN-13 check digit), and that
+ * number alone identifies the book: equality, ordering and hashing ignore
+ * the rest. The bits above remember how the ISBN was written so str()
+ * gives it back exactly:
+ *
+ *   bits 44-55  a hyphen after digit i (i = 0 .. 11)
+ *   bit  56     written as an ISBN-10
+ *   bits 57-60  the ISBN-10's own check character (10 for X)
+ *
+ * Parsing is lenient about ISBN-13 check digits, which much of the
+ * catalog gets wrong: the written digit is kept as part of the number, and
+ * checksumValid() reports it. An ISBN-10's check digit has no place in the
+ * number, so one that is wrong is rejected rather than read as the same
+ * book as the right one.
+ */
+struct ISBN {
+    uint64_t packed;
+
+    ISBN() : packed(0) {}
+    explicit ISBN(uint64_t p) : packed(p) {}
+
+    static const unsigned ID_BITS = 44;
+    static const uint64_t ID_MASK = (1ULL << ID_BITS) - 1;
+
+    uint64_t id() const { return packed & ID_MASK; }
+    bool empty() const { return id() == 0; }
+
+    bool operator==(const ISBN& o) const { return id() == o.id(); }
+    bool operator!=(const ISBN& o) const { return id() != o.id(); }
+    bool operator<(const ISBN& o) const { return id() < o.id(); }
+
+    // ISBN-13 ("978-0-13-110362-7", "9780131103627") or ISBN-10 with a
+    // correct check digit ("0-13-110362-8", "080442957X"), digits
+    // optionally separated by single hyphens. False, leaving out alone, for
+    // anything else.
+    static bool parse(const std::string& text, ISBN& out);
+
+    // Numbers of the ISBNs that start with prefix, as [first, last). The
+    // prefix is the leading digits of an ISBN-13 ("978-0-13") or, when it
+    // does not start with 978 or 979, of an ISBN-10 ("0-13"); hyphens are
+    // ignored. An empty prefix, "9" and "97" cover every ISBN. False if it
+    // has anything else or too many digits.
+    static bool prefixRange(const std::string& prefix, uint64_t& first, uint64_t& last);
+
+    std::string str() const;
+    bool checksumValid() const;
+};
+
+namespace std {
+template <> struct hash<ISBN> {
+    size_t operator()(const ISBN& isbn) const { return std::hash<uint64_t>()(isbn.id()); }
+};
+}
+
+#endif
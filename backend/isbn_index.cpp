@@ -0,0 +1,246 @@
+#include "isbn_index.h"
+#include "parallel.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Smallest insert buffer worth a merge; below this a rebuild per handful
+// of inserts would dominate.
+const size_t MIN_PENDING = 32;
+
+// Arrays smaller than this are filled on the calling thread.
+const size_t MIN_PARALLEL = 1 << 16;
+
+bool byISBN(const Book* a, const Book* b) {
+    return a->isbn < b->isbn;
+}
+
+bool keyBelow(const Book* b, const ISBN& key) {
+    return b->isbn < key;
+}
+
+bool idBelow(const Book* b, uint64_t key) {
+    return b->isbn.id() < key;
+}
+
+}
+
+ISBNIndex::ISBNIndex() : keys(1, 0), bookAt(1, nullptr) {}
+
+// Eytzinger index of the first key not below key, or 0 if there is none.
+size_t ISBNIndex::lowerSlot(uint64_t key) const {
+    size_t n = size();
+    size_t k = 1;
+    while (k <= n) {
+        // The four grandchildren share a cache line; fetch it a level early.
+        __builtin_prefetch(keys.data() + (4 * k <= n ? 4 * k : 0));
+        k = 2 * k + (keys[k] < key);
+    }
+    // Undo the right turns taken after the last left turn.
+    return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+}
+
+size_t ISBNIndex::firstInOrder(size_t n) {
+    if (n == 0) return 0;
+    size_t k = 1;
+    while (2 * k <= n) k = 2 * k;
+    return k;
+}
+
+size_t ISBNIndex::lastInOrder(size_t n) {
+    if (n == 0) return 0;
+    size_t k = 1;
+    while (2 * k + 1 <= n) k = 2 * k + 1;
+    return k;
+}
+
+size_t ISBNIndex::nextInOrder(size_t k, size_t n) {
+    if (2 * k + 1 <= n) {
+        k = 2 * k + 1;
+        while (2 * k <= n) k = 2 * k;
+        return k;
+    }
+    while (k & 1) k >>= 1;
+    return k >> 1;
+}
+
+size_t ISBNIndex::prevInOrder(size_t k, size_t n) {
+    if (2 * k <= n) {
+        k = 2 * k;
+        while (2 * k + 1 <= n) k = 2 * k + 1;
+        return k;
+    }
+    while (k > 1 && !(k & 1)) k >>= 1;
+    return k >> 1;
+}
+
+size_t ISBNIndex::subtreeSize(size_t k, size_t n) {
+    size_t count = 0;
+    for (size_t width = 1; k <= n; k *= 2, width *= 2)
+        count += std::min(width, n - k + 1);
+    return count;
+}
+
+// Fills the subtree at slot k with sorted[next ..] in order.
+void ISBNIndex::place(const std::vector<Book*>& sorted, size_t& next, size_t k) {
+    if (k > size()) return;
+    place(sorted, next, 2 * k);
+    keys[k] = sorted[next]->isbn.id();
+    bookAt[k] = sorted[next++];
+    place(sorted, next, 2 * k + 1);
+}
+
+// Fills the top depth levels below slot k here and leaves a job per
+// subtree under them. Each subtree's first book is known from the sizes
+// of the subtrees before it, so the jobs write disjoint slots.
+void ISBNIndex::placeTop(const std::vector<Book*>& sorted, size_t first, size_t k,
+                         unsigned depth, std::vector<std::function<void()>>& jobs) {
+    if (k > size()) return;
+    if (depth == 0) {
+        jobs.push_back([this, &sorted, first, k] {
+            size_t next = first;
+            place(sorted, next, k);
+        });
+        return;
+    }
+
+    size_t left = subtreeSize(2 * k, size());
+    placeTop(sorted, first, 2 * k, depth - 1, jobs);
+    keys[k] = sorted[first + left]->isbn.id();
+    bookAt[k] = sorted[first + left];
+    placeTop(sorted, first + left + 1, 2 * k + 1, depth - 1, jobs);
+}
+
+void ISBNIndex::rebuild(const std::vector<Book*>& sorted, unsigned threads) {
+    keys.assign(sorted.size() + 1, 0);
+    bookAt.assign(sorted.size() + 1, nullptr);
+    pending.clear();
+
+    unsigned workers = resolveThreads(threads);
+    if (workers == 1 || sorted.size() < MIN_PARALLEL) {
+        size_t next = 0;
+        place(sorted, next, 1);
+        return;
+    }
+
+    // A few subtrees per worker evens out the ragged last level.
+    unsigned depth = 0;
+    while ((1u << depth) < 4 * workers) depth++;
+    std::vector<std::function<void()>> jobs;
+    placeTop(sorted, 0, 1, depth, jobs);
+    runConcurrently(jobs, workers);
+}
+
+void ISBNIndex::insert(const ISBN& key, Book* book) {
+    if (search(key)) return;
+
+    pending.insert(std::lower_bound(pending.begin(), pending.end(), book, byISBN), book);
+    if (pending.size() > std::max(MIN_PENDING, size() / 8))
+        rebuild(getAllBooks());
+}
+
+void ISBNIndex::remove(const ISBN& key) {
+    auto it = std::lower_bound(pending.begin(), pending.end(), key, keyBelow);
+    if (it != pending.end() && (*it)->isbn == key) {
+        pending.erase(it);
+        return;
+    }
+
+    size_t k = lowerSlot(key.id());
+    if (k == 0 || keys[k] != key.id()) return;
+
+    std::vector<Book*> all = getAllBooks();
+    all.erase(std::lower_bound(all.begin(), all.end(), key, keyBelow));
+    rebuild(all);
+}
+
+void ISBNIndex::insertSorted(const std::vector<Book*>& sorted, unsigned threads) {
+    if (sorted.empty()) return;
+    if (size() == 0 && pending.empty()) {
+        rebuild(sorted, threads);
+        return;
+    }
+
+    std::vector<Book*> indexed = getAllBooks();
+    std::vector<Book*> all;
+    all.reserve(indexed.size() + sorted.size());
+    std::merge(indexed.begin(), indexed.end(), sorted.begin(), sorted.end(),
+               std::back_inserter(all), byISBN);
+    rebuild(all, threads);
+}
+
+Book* ISBNIndex::search(const ISBN& key) const {
+    size_t k = lowerSlot(key.id());
+    if (k != 0 && keys[k] == key.id()) return bookAt[k];
+
+    if (pending.empty()) return nullptr;
+    auto it = std::lower_bound(pending.begin(), pending.end(), key, keyBelow);
+    return it != pending.end() && (*it)->isbn == key ? *it : nullptr;
+}
+
+/* ================= ORDERED SCANS ================= */
+
+bool ISBNIndex::Iterator::bufferFirst() const {
+    const std::vector<Book*>& pending = index->pending;
+    return buffered < pending.size() &&
+           (slot == 0 || pending[buffered]->isbn.id() < index->keys[slot]);
+}
+
+Book* ISBNIndex::Iterator::operator*() const {
+    return bufferFirst() ? index->pending[buffered] : index->bookAt[slot];
+}
+
+ISBNIndex::Iterator& ISBNIndex::Iterator::operator++() {
+    if (bufferFirst()) buffered++;
+    else slot = nextInOrder(slot, index->size());
+    return *this;
+}
+
+ISBNIndex::Iterator& ISBNIndex::Iterator::operator--() {
+    size_t n = index->size();
+    size_t before = slot == 0 ? lastInOrder(n) : prevInOrder(slot, n);
+
+    // Step back on whichever side holds the larger predecessor.
+    if (buffered > 0 &&
+        (before == 0 || index->pending[buffered - 1]->isbn.id() > index->keys[before]))
+        buffered--;
+    else
+        slot = before;
+    return *this;
+}
+
+ISBNIndex::Iterator ISBNIndex::seek(uint64_t key) const {
+    auto it = std::lower_bound(pending.begin(), pending.end(), key, idBelow);
+    return Iterator(this, lowerSlot(key), it - pending.begin());
+}
+
+ISBNIndex::Iterator ISBNIndex::begin() const {
+    return Iterator(this, firstInOrder(size()), 0);
+}
+
+ISBNIndex::Iterator ISBNIndex::end() const {
+    return Iterator(this, 0, pending.size());
+}
+
+ISBNIndex::Iterator ISBNIndex::lowerBound(const ISBN& key) const {
+    return seek(key.id());
+}
+
+ISBNIndex::Iterator ISBNIndex::upperBound(const ISBN& key) const {
+    return seek(key.id() + 1);
+}
+
+std::pair<ISBNIndex::Iterator, ISBNIndex::Iterator>
+ISBNIndex::range(uint64_t first, uint64_t last) const {
+    if (last < first) last = first;
+    return { seek(first), seek(last) };
+}
+
+std::vector<Book*> ISBNIndex::getAllBooks() const {
+    std::vector<Book*> books;
+    books.reserve(size() + pending.size());
+    for (Iterator it = begin(); it != end(); ++it)
+        books.push_back(*it);
+    return books;
+}
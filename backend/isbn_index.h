@@ -0,0 +1,112 @@
+#ifndef ISBN_INDEX_H
+#define ISBN_INDEX_H
+
+#include "models.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <functional>
+
+/*
+ * Sorted ISBN -> Book* index laid out for the cache rather than with
+ * pointers. The bulk of the keys sit in an Eytzinger array: the sorted
+ * keys in breadth-first order of an implicit balanced tree, so node k's
+ * children are 2k and 2k+1 and the top levels share a few cache lines. A
+ * lookup descends without branching on the comparison and prefetches the
+ * grandchildren's line while comparing. Keys are the ISBNs' 64-bit
+ * numbers, eight to a cache line, and a lookup touches no Book until it
+ * has found the match.
+ *
+ * Books added at runtime go to a small sorted insert buffer that is merged
+ * into the array once it grows past an eighth of it. Removals are rare
+ * catalog edits and rebuild the array.
+ *
+ * In-order successor and predecessor are index arithmetic on the implicit
+ * tree, so iterators and range scans cost O(log n) to seek and amortized
+ * O(1) per step.
+ */
+class ISBNIndex {
+private:
+    // 1-based Eytzinger order; index 0 is unused.
+    std::vector<uint64_t> keys;
+    std::vector<Book*> bookAt;
+
+    std::vector<Book*> pending;         // insert buffer, sorted by ISBN
+
+    size_t size() const { return bookAt.size() - 1; }
+    size_t lowerSlot(uint64_t key) const;
+    static size_t firstInOrder(size_t n);
+    static size_t lastInOrder(size_t n);
+    static size_t nextInOrder(size_t k, size_t n);
+    static size_t prevInOrder(size_t k, size_t n);
+    static size_t subtreeSize(size_t k, size_t n);
+    void place(const std::vector<Book*>& sorted, size_t& next, size_t k);
+    void placeTop(const std::vector<Book*>& sorted, size_t first, size_t k,
+                  unsigned depth, std::vector<std::function<void()>>& jobs);
+    void rebuild(const std::vector<Book*>& sorted, unsigned threads = 0);
+
+public:
+    class Iterator;
+
+private:
+    Iterator seek(uint64_t key) const;
+
+public:
+    /*
+     * Walks the books in ISBN order, both ways, merging the array and the
+     * insert buffer as it goes. It stands before the next book of each:
+     * an Eytzinger slot (0 once the array is done) and a buffer position.
+     * Any insert or remove invalidates it.
+     */
+    class Iterator {
+    private:
+        friend class ISBNIndex;
+        const ISBNIndex* index;
+        size_t slot;
+        size_t buffered;
+
+        Iterator(const ISBNIndex* index, size_t slot, size_t buffered)
+            : index(index), slot(slot), buffered(buffered) {}
+
+        bool bufferFirst() const;
+
+    public:
+        Book* operator*() const;
+        Iterator& operator++();
+        Iterator& operator--();
+
+        bool operator==(const Iterator& o) const {
+            return slot == o.slot && buffered == o.buffered;
+        }
+        bool operator!=(const Iterator& o) const { return !(*this == o); }
+    };
+
+    ISBNIndex();
+
+    void insert(const ISBN& key, Book* book);
+    void remove(const ISBN& key);
+
+    // Adds books sorted by ISBN, none of them indexed yet, with one merge
+    // and an O(n) rebuild rather than an insert each. Large arrays are
+    // filled on up to `threads` threads (0 = one per core).
+    void insertSorted(const std::vector<Book*>& sorted, unsigned threads = 0);
+    Book* search(const ISBN& key) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    // First book whose ISBN is not below key, and first above it.
+    Iterator lowerBound(const ISBN& key) const;
+    Iterator upperBound(const ISBN& key) const;
+
+    // Books whose ISBN numbers lie in [first, last), e.g. a prefix's
+    // ISBN::prefixRange. Costs two lookups; nothing outside is visited.
+    std::pair<Iterator, Iterator> range(uint64_t first, uint64_t last) const;
+
+    // Every book in ISBN order.
+    std::vector<Book*> getAllBooks() const;
+};
+
+#endif
@@ -0,0 +1,313 @@
+#include "journal.h"
+#include "crc32.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char JOURNAL_MAGIC[8] = { 'L', 'I', 'B', 'J', 'R', 'N', 'L', '\0' };
+const uint32_t JOURNAL_VERSION = 1;
+const size_t HEADER_SIZE = sizeof JOURNAL_MAGIC + sizeof(uint32_t);
+const uint32_t MAX_PAYLOAD = 1 << 20;
+
+/* ---------------- FILE ACCESS ---------------- */
+
+#ifdef _WIN32
+
+int openForAppend(const std::string& path) {
+    return _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        int n = _write(fd, data, static_cast<unsigned>(length));
+        if (n <= 0) return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+void syncFile(int fd) { _commit(fd); }
+void closeFile(int fd) { _close(fd); }
+
+#else
+
+int openForAppend(const std::string& path) {
+    return open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+}
+
+bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+void syncFile(int fd) { fsync(fd); }
+void closeFile(int fd) { close(fd); }
+
+#endif
+
+/* ---------------- ENCODING ---------------- */
+
+template <class T>
+void putValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+void putField(std::string& out, const std::string& s) {
+    putValue<uint16_t>(out, s.size());
+    out += s;
+}
+
+template <class T>
+bool getValue(const char*& p, const char* end, T& value) {
+    if (static_cast<size_t>(end - p) < sizeof value) return false;
+    std::memcpy(&value, p, sizeof value);
+    p += sizeof value;
+    return true;
+}
+
+bool getField(const char*& p, const char* end, std::string& s) {
+    uint16_t length;
+    if (!getValue(p, end, length) || static_cast<size_t>(end - p) < length) return false;
+    s.assign(p, length);
+    p += length;
+    return true;
+}
+
+bool decodePayload(const char* p, const char* end, JournalRecord& r) {
+    int64_t timestamp;
+    uint8_t op;
+    if (!getValue(p, end, r.sequence) || !getValue(p, end, timestamp) ||
+        !getValue(p, end, op) || !getField(p, end, r.userID) || !getField(p, end, r.isbn))
+        return false;
+    if (op < static_cast<uint8_t>(JournalOp::ISSUE) || op > static_cast<uint8_t>(JournalOp::EXPIRE))
+        return false;
+    r.timestamp = timestamp;
+    r.op = static_cast<JournalOp>(op);
+    return p == end;
+}
+
+}
+
+/* ================= RECOVERY ================= */
+
+std::string Journal::segmentPath(const std::string& base, uint64_t index) {
+    char suffix[24];
+    std::snprintf(suffix, sizeof suffix, ".%06llu", static_cast<unsigned long long>(index));
+    return base + suffix;
+}
+
+// Indexes of the existing segments, ascending.
+std::vector<uint64_t> Journal::segments(const std::string& base) {
+    namespace fs = std::filesystem;
+    std::vector<uint64_t> found;
+
+    fs::path dir = fs::path(base).parent_path();
+    std::string prefix = fs::path(base).filename().string() + ".";
+    std::error_code ec;
+
+    for (fs::directory_iterator it(dir.empty() ? "." : dir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) continue;
+        std::string digits = name.substr(prefix.size());
+        if (digits.find_first_not_of("0123456789") != std::string::npos) continue;
+        found.push_back(std::stoull(digits));
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+std::vector<JournalRecord> Journal::recover(const std::string& base) {
+    std::vector<JournalRecord> records;
+    for (uint64_t index : segments(base))
+        recoverSegment(segmentPath(base, index), records);
+    return records;
+}
+
+void Journal::removeSegmentsBefore(const std::string& base, uint64_t index) {
+    std::error_code ec;
+    for (uint64_t k : segments(base))
+        if (k < index) std::filesystem::remove(segmentPath(base, k), ec);
+}
+
+void Journal::recoverSegment(const std::string& path, std::vector<JournalRecord>& records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t valid = 0;
+    if (data.size() >= HEADER_SIZE) {
+        uint32_t version;
+        std::memcpy(&version, data.data() + sizeof JOURNAL_MAGIC, sizeof version);
+        if (std::memcmp(data.data(), JOURNAL_MAGIC, sizeof JOURNAL_MAGIC) != 0 ||
+            version != JOURNAL_VERSION)
+            throw std::runtime_error("Not a journal file: " + path);
+        valid = HEADER_SIZE;
+    }
+
+    // valid stays 0 for a header cut short, so the file restarts empty.
+    while (valid > 0 && data.size() - valid >= 2 * sizeof(uint32_t)) {
+        const char* p = data.data() + valid;
+        uint32_t length, checksum;
+        std::memcpy(&length, p, sizeof length);
+        std::memcpy(&checksum, p + sizeof length, sizeof checksum);
+        p += 2 * sizeof(uint32_t);
+
+        if (length > MAX_PAYLOAD || data.size() - valid - 2 * sizeof(uint32_t) < length) break;
+        if (crc32(p, length) != checksum) break;
+
+        JournalRecord r;
+        if (!decodePayload(p, p + length, r)) break;
+        if (!records.empty() && r.sequence <= records.back().sequence) break;
+
+        records.push_back(r);
+        valid += 2 * sizeof(uint32_t) + length;
+    }
+
+    if (valid < data.size())
+        std::filesystem::resize_file(path, valid);
+}
+
+/* ================= APPEND / GROUP COMMIT ================= */
+
+Journal::Journal(const std::string& journalBase, uint64_t next, const JournalOptions& opts)
+    : base(journalBase), segment(0), fd(-1), nextSequence(next),
+      written(0), segmentRecords(0), durable(0),
+      stopping(false), urgent(false), options(opts) {
+    std::vector<uint64_t> existing = segments(base);
+    openSegment(existing.empty() ? 1 : existing.back() + 1);
+    flusher = std::thread(&Journal::flushLoop, this);
+}
+
+void Journal::openSegment(uint64_t index) {
+    std::string path = segmentPath(base, index);
+    int newFd = openForAppend(path);
+    if (newFd < 0)
+        throw std::runtime_error("Cannot open journal " + path);
+
+    std::string header(JOURNAL_MAGIC, sizeof JOURNAL_MAGIC);
+    putValue<uint32_t>(header, JOURNAL_VERSION);
+    if (!writeAll(newFd, header.data(), header.size())) {
+        closeFile(newFd);
+        throw std::runtime_error("Cannot write journal " + path);
+    }
+    syncFile(newFd);
+
+    fd = newFd;
+    segment = index;
+    segmentRecords = 0;
+}
+
+uint64_t Journal::rotate() {
+    sync();
+
+    // The flusher is idle now (nothing unsynced) and append() runs on the
+    // caller's thread, so the descriptor can be swapped under the lock.
+    std::lock_guard<std::mutex> lock(mutex);
+    int old = fd;
+    openSegment(segment + 1);
+    closeFile(old);
+    return segment;
+}
+
+Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    flusher.join();
+    closeFile(fd);
+
+    // Don't leave a header-only segment behind for every restart.
+    if (segmentRecords == 0) {
+        std::error_code ec;
+        std::filesystem::remove(segmentPath(base, segment), ec);
+    }
+}
+
+uint64_t Journal::append(JournalOp op, long long timestamp,
+                         const std::string& userID, const std::string& isbn) {
+    if (userID.size() > UINT16_MAX || isbn.size() > UINT16_MAX)
+        throw std::runtime_error("Journal field too long");
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::string payload;
+    putValue<uint64_t>(payload, nextSequence);
+    putValue<int64_t>(payload, timestamp);
+    putValue<uint8_t>(payload, static_cast<uint8_t>(op));
+    putField(payload, userID);
+    putField(payload, isbn);
+
+    std::string record;
+    putValue<uint32_t>(record, payload.size());
+    putValue<uint32_t>(record, crc32(payload.data(), payload.size()));
+    record += payload;
+
+    if (!writeAll(fd, record.data(), record.size()))
+        throw std::runtime_error("Journal write failed");
+
+    written++;
+    segmentRecords++;
+    wake.notify_one();
+    return nextSequence++;
+}
+
+void Journal::sync() {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t target = written;
+    if (durable >= target) return;
+
+    urgent = true;
+    wake.notify_one();
+    synced.wait(lock, [this, target] { return durable >= target; });
+}
+
+void Journal::flushLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || written > durable; });
+        if (written == durable) return;     // stopping, nothing outstanding
+
+        // Let a batch build up unless it is already full or someone waits.
+        wake.wait_for(lock, std::chrono::milliseconds(options.commitIntervalMs), [this] {
+            return stopping || urgent || written - durable >= options.commitRecords;
+        });
+
+        uint64_t target = written;
+        int syncFd = fd;
+        lock.unlock();
+        syncFile(syncFd);
+        lock.lock();
+
+        durable = target;
+        if (durable == written) urgent = false;
+        synced.notify_all();
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+/*
+ * Append-only write-ahead journal for circulation operations.
+ *
+ * The journal is a series of segment files <base>.000001, <base>.000002 ...
+ * A new segment is started on every open and by rotate(), so a checkpoint
+ * can drop the segments it covers as whole files.
+ *
+ * Segment: an 8-byte magic and a uint32 version, then records of
+ *   uint32 payload length | uint32 CRC32 of payload | payload
+ * where the payload is
+ *   uint64 sequence | int64 timestamp | uint8 op |
+ *   uint16 length + user ID | uint16 length + ISBN
+ *
+ * append() writes the record straight to the file, so it survives a crash
+ * of the process. A background thread batches fsync (group commit): it
+ * syncs once commitRecords records are waiting or commitIntervalMs has
+ * passed since the oldest unsynced one, so a request never waits on the
+ * disk. Only an OS crash or power loss inside that window can lose records.
+ */
+
+enum class JournalOp : uint8_t { ISSUE = 1, RETURN, RESERVE, UNDO, CANCEL, EXPIRE };
+
+struct JournalRecord {
+    uint64_t sequence;
+    long long timestamp;
+    JournalOp op;
+    std::string userID;
+    std::string isbn;
+};
+
+struct JournalOptions {
+    unsigned commitIntervalMs;
+    unsigned commitRecords;
+
+    JournalOptions() : commitIntervalMs(20), commitRecords(64) {}
+};
+
+class Journal {
+private:
+    std::string base;
+    uint64_t segment;                   // index of the segment being appended to
+    int fd;
+
+    std::mutex mutex;
+    std::condition_variable wake;       // flusher: work or shutdown
+    std::condition_variable synced;     // sync(): progress
+    uint64_t nextSequence;
+    uint64_t written;                   // records written by append()
+    uint64_t segmentRecords;            // records in the current segment
+    uint64_t durable;                   // records covered by a finished fsync
+    bool stopping;
+    bool urgent;                        // a sync() caller is waiting
+    JournalOptions options;
+    std::thread flusher;
+
+    void flushLoop();
+    void openSegment(uint64_t index);
+
+    static std::string segmentPath(const std::string& base, uint64_t index);
+    static std::vector<uint64_t> segments(const std::string& base);
+    static void recoverSegment(const std::string& path, std::vector<JournalRecord>& records);
+
+public:
+    // Every intact record of every segment, in order. A torn or corrupt
+    // tail (a crash part-way through a write) is cut off. No segments
+    // yield no records. Throws std::runtime_error if a segment is not a
+    // journal file.
+    static std::vector<JournalRecord> recover(const std::string& base);
+
+    // Deletes the segments numbered below index (covered by a checkpoint).
+    static void removeSegmentsBefore(const std::string& base, uint64_t index);
+
+    // Starts a new segment after the existing ones; sequence numbers
+    // continue from nextSequence. Throws std::runtime_error.
+    Journal(const std::string& base, uint64_t nextSequence, const JournalOptions& options);
+
+    // Syncs whatever is outstanding and stops the flusher.
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Writes one record without waiting for fsync and returns its sequence
+    // number. Throws std::runtime_error if the write fails.
+    uint64_t append(JournalOp op, long long timestamp,
+                    const std::string& userID, const std::string& isbn);
+
+    // Blocks until every record appended so far is on disk.
+    void sync();
+
+    // Syncs and closes the current segment and starts the next one.
+    // Returns the new segment's index: every earlier segment is sealed.
+    // Must not race with append().
+    uint64_t rotate();
+};
+
+#endif
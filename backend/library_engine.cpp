@@ -1,29 +1,50 @@
 #include "library_engine.h"
+#include "parallel.h"
 #include <sstream>
 #include <map>
 #include <vector>
 #include <unordered_set>
 #include <algorithm>
 #include <ctime>
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <iterator>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 /* ================= CONSTRUCTOR / DESTRUCTOR ================= */
 
 LibraryEngine::LibraryEngine()
-    : transactionCounter(0), reservationCounter(0) {}
+    : bookLookup(BookLookup::ISBN_INDEX),
+      titleTrie(docTable), authorTrie(docTable), rankedIndex(docTable),
+      substringIndex(docTable), rankGeneration(0),
+      holdTimers(time(nullptr)), holdSerial(0),
+      transactionCounter(0), reservationCounter(0),
+      journal(nullptr), journalSequence(0), replayTime(0), catalogSource(0),
+      checkpointPid(0), checkpointSegment(0), checkpointSequence(0),
+      pendingSequence(0) {}
 
 LibraryEngine::~LibraryEngine() {
+    delete journal;
+
     for (auto& b : books) delete b.second;
     for (auto& u : users) delete u.second;
 
-    for (auto& q : reservationQueues) {
-        while (!q.second.empty()) {
-            delete q.second.top();
-            q.second.pop();
-        }
-    }
+    for (auto& q : reservationQueues)
+        while (!q.second.empty())
+            delete q.second.pop();
+
+    for (auto& shelf : holdsByBook)
+        for (Hold* h : shelf.second) deleteHold(h);
 
     while (!transactionHistory.empty()) {
-        delete transactionHistory.top();
+        deleteTransaction(transactionHistory.top());
         transactionHistory.pop();
     }
 }
@@ -31,14 +52,207 @@ LibraryEngine::~LibraryEngine() {
 /* ================= BOOKS ================= */
 
 void LibraryEngine::addBook(Book* book) {
+    // First row wins, matching what the ISBN index already returned.
+    if (books.count(book->isbn)) {
+        delete book;
+        return;
+    }
+
+    book->docID = docTable.size();
+    docTable.push_back(book);
     books[book->isbn] = book;
     bookISBNIndex.insert(book->isbn, book);
+    if (bookLookup == BookLookup::PERFECT_HASH) bookHash.insert(book->isbn, book);
 }
 
-Book* LibraryEngine::getBook(const std::string& isbn) {
+void LibraryEngine::addBooks(const std::vector<Book*>& batch) {
+    docTable.reserve(docTable.size() + batch.size());
+    books.reserve(books.size() + batch.size());
+
+    std::vector<Book*> added;
+    added.reserve(batch.size());
+    for (Book* b : batch) {
+        if (books.count(b->isbn)) {
+            delete b;
+            continue;
+        }
+        b->docID = docTable.size();
+        docTable.push_back(b);
+        books[b->isbn] = b;
+        added.push_back(b);
+    }
+
+    // One sort and a linear build of the ISBN index, not an insert per row.
+    std::sort(added.begin(), added.end(),
+              [](const Book* a, const Book* b) { return a->isbn < b->isbn; });
+    bookISBNIndex.insertSorted(added);
+    if (bookLookup == BookLookup::PERFECT_HASH && !added.empty())
+        bookHash.build(bookISBNIndex.getAllBooks());
+}
+
+Book* LibraryEngine::getBook(const ISBN& isbn) {
+    if (bookLookup == BookLookup::PERFECT_HASH) return bookHash.search(isbn);
     return bookISBNIndex.search(isbn);
 }
 
+Book* LibraryEngine::getBook(const std::string& isbn) {
+    ISBN key;
+    return ISBN::parse(isbn, key) ? getBook(key) : nullptr;
+}
+
+// The hash is built whenever it is selected and emptied when it is not.
+void LibraryEngine::setBookLookup(BookLookup lookup) {
+    if (lookup == bookLookup) return;
+    bookLookup = lookup;
+    bookHash.build(lookup == BookLookup::PERFECT_HASH ? bookISBNIndex.getAllBooks()
+                                                      : std::vector<Book*>());
+}
+
+/* ================= CATALOG MAINTENANCE ================= */
+
+void LibraryEngine::indexBook(Book* book) {
+    for (const auto& word : tokenize(book->title)) titleTrie.insert(word, book->docID);
+    for (const auto& word : tokenize(book->author)) authorTrie.insert(word, book->docID);
+    rankedIndex.addDocument(book->docID);
+}
+
+// Runs while the book still carries the text it was indexed with.
+void LibraryEngine::unindexBook(Book* book) {
+    for (const auto& word : tokenize(book->title)) titleTrie.remove(word, book->docID);
+    for (const auto& word : tokenize(book->author)) authorTrie.remove(word, book->docID);
+    rankedIndex.removeDocument(book->docID);
+}
+
+json LibraryEngine::addCatalogBook(
+    const std::string& isbn, const std::string& title,
+    const std::string& author, const std::string& category,
+    int copies
+) {
+    json res;
+    ISBN key;
+
+    if (isbn.empty() || title.empty() || copies < 1) {
+        res["success"] = false;
+        res["message"] = "ISBN, title and at least one copy are required";
+        return res;
+    }
+    if (!ISBN::parse(isbn, key)) {
+        res["success"] = false;
+        res["message"] = "Invalid ISBN";
+        return res;
+    }
+    if (getBook(key)) {
+        res["success"] = false;
+        res["message"] = "Book already exists";
+        return res;
+    }
+
+    Book* book = new Book(key, title, author, category, copies);
+    addBook(book);
+    indexBook(book);
+    substringIndex.addDocument(book->docID);
+    recommendations.addBook(key, category);
+    rankGeneration++;
+
+    res["success"] = true;
+    res["message"] = "Book added successfully";
+    return res;
+}
+
+json LibraryEngine::updateCatalogBook(const std::string& isbn, const json& changes) {
+    json res;
+    Book* book = getBook(isbn);
+
+    if (!book) {
+        res["success"] = false;
+        res["message"] = "Book not found";
+        return res;
+    }
+
+    std::string title = changes.value("title", book->title);
+    std::string author = changes.value("author", book->author);
+    std::string category = changes.value("category", book->category);
+    int copies = changes.value("copies", book->totalCopies);
+
+    // A failed setTotalCopies (copies out above the new count) changes
+    // nothing, so it goes before the text edits.
+    if (title.empty() || copies < 1 || !book->setTotalCopies(copies)) {
+        res["success"] = false;
+        res["message"] = "Invalid update";
+        return res;
+    }
+
+    std::string oldCategory = book->category;
+
+    if (title != book->title || author != book->author || category != oldCategory) {
+        unindexBook(book);
+        book->title = title;
+        book->author = author;
+        book->category = category;
+        indexBook(book);
+        substringIndex.addDocument(book->docID);
+    }
+
+    if (category != oldCategory) {
+        recommendations.removeBook(book->isbn, oldCategory);
+        recommendations.addBook(book->isbn, category);
+    }
+
+    rankGeneration++;
+
+    res["success"] = true;
+    res["message"] = "Book updated successfully";
+    res["availableCopies"] = book->availableCopies;
+    return res;
+}
+
+json LibraryEngine::removeCatalogBook(const std::string& isbn) {
+    json res;
+    Book* book = getBook(isbn);
+
+    if (!book) {
+        res["success"] = false;
+        res["message"] = "Book not found";
+        return res;
+    }
+    if (book->availableCopies != book->totalCopies) {
+        res["success"] = false;
+        res["message"] = "Book has copies on loan";
+        return res;
+    }
+
+    ISBN key = book->isbn;
+    unindexBook(book);
+    substringIndex.removeDocument(book->docID);
+    recommendations.removeBook(key, book->category);
+    bookISBNIndex.remove(key);
+    if (bookLookup == BookLookup::PERFECT_HASH) bookHash.remove(key);
+    books.erase(key);
+    docTable[book->docID] = nullptr;
+
+    auto q = reservationQueues.find(key);
+    if (q != reservationQueues.end()) {
+        for (Reservation* r : q->second.ordered()) {
+            dropReservation(r);
+            delete r;
+        }
+    }
+
+    delete book;
+    rankGeneration++;
+
+    res["success"] = true;
+    res["message"] = "Book removed successfully";
+    return res;
+}
+
+std::vector<Book*> LibraryEngine::getCatalog() {
+    std::vector<Book*> live;
+    for (Book* b : docTable)
+        if (b) live.push_back(b);
+    return live;
+}
+
 /* ================= USERS ================= */
 
 void LibraryEngine::addUser(User* user) {
@@ -52,24 +266,225 @@ User* LibraryEngine::getUser(const std::string& userID) {
 
 /* ================= SEARCH ================= */
 
-void LibraryEngine::buildSearchIndices() {
-    for (auto& p : books) {
-        Book* b = p.second;
+std::vector<std::string> LibraryEngine::tokenize(const std::string& text) {
+    std::istringstream ss(text);
+    std::vector<std::string> words;
+    std::string word;
+    while (ss >> word) words.push_back(word);
+    return words;
+}
+
+void LibraryEngine::buildSearchIndices(unsigned threads) {
+    // The indexes share nothing but the read-only doc table, so each is
+    // built by its own job. docID order keeps every posting list append-only.
+    std::vector<std::function<void()>> jobs = {
+        [this] {
+            for (Book* b : docTable)
+                if (b) for (const auto& word : tokenize(b->title)) titleTrie.insert(word, b->docID);
+        },
+        [this] {
+            for (Book* b : docTable)
+                if (b) for (const auto& word : tokenize(b->author)) authorTrie.insert(word, b->docID);
+        },
+        [this] {
+            for (Book* b : docTable)
+                if (b) rankedIndex.addDocument(b->docID);
+        },
+        [this] { substringIndex.build(); }
+    };
+    runConcurrently(jobs, threads);
+}
+
+// Cursors are the last hit of a page: the score's bit pattern followed by
+// the docID, as 24 hex digits.
+static std::string encodeCursor(const ScoredDoc& d) {
+    uint64_t bits;
+    std::memcpy(&bits, &d.score, sizeof bits);
+    char buf[25];
+    std::snprintf(buf, sizeof buf, "%016llx%08x",
+                  static_cast<unsigned long long>(bits), static_cast<unsigned>(d.docID));
+    return buf;
+}
+
+static ScoredDoc decodeCursor(const std::string& cursor) {
+    if (cursor.size() != 24 ||
+        cursor.find_first_not_of("0123456789abcdef") != std::string::npos)
+        throw std::invalid_argument("Invalid cursor");
+
+    uint64_t bits = std::stoull(cursor.substr(0, 16), nullptr, 16);
+    ScoredDoc d;
+    std::memcpy(&d.score, &bits, sizeof bits);
+    d.docID = static_cast<uint32_t>(std::stoul(cursor.substr(16), nullptr, 16));
+    return d;
+}
+
+// Keep the k best hits (all when k == 0) in rank order: nth_element picks
+// the page in O(n), then only the page itself is sorted.
+static void selectTop(std::vector<ScoredDoc>& hits, size_t k) {
+    if (k > 0 && hits.size() > k) {
+        std::nth_element(hits.begin(), hits.begin() + k, hits.end(), rankedBefore);
+        hits.resize(k);
+    }
+    std::sort(hits.begin(), hits.end(), rankedBefore);
+}
+
+std::vector<ScoredDoc> LibraryEngine::scoreByImpact(const std::vector<uint32_t>& ids) {
+    std::vector<ScoredDoc> hits;
+    hits.reserve(ids.size());
+    for (uint32_t id : ids)
+        hits.push_back({ id, static_cast<double>(docTable[id]->borrowImpact) });
+    return hits;
+}
+
+// Every word is a (possibly typo-tolerant) prefix posting list; the lists
+// are ANDed smallest first.
+std::vector<uint32_t> LibraryEngine::matchField(
+    AdaptiveTrie& trie, const std::vector<std::string>& tokens, int maxEdits
+) {
+    if (tokens.empty()) return trie.prefixPostings("");
+
+    std::vector<std::vector<uint32_t>> lists;
+    for (const auto& token : tokens) {
+        lists.push_back(maxEdits > 0
+            ? trie.fuzzyPostings(token, maxEdits)
+            : trie.prefixPostings(token));
+        if (lists.back().empty()) return {};
+    }
+
+    std::sort(lists.begin(), lists.end(),
+        [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+            return a.size() < b.size();
+        });
+
+    std::vector<uint32_t> ids = lists[0];
+    for (size_t i = 1; i < lists.size() && !ids.empty(); i++)
+        ids = intersectGalloping(ids, lists[i]);
+    return ids;
+}
+
+// Every backend is case- and whitespace-insensitive, so queries that only
+// differ in those share a cache entry.
+static std::string cacheKey(const SearchQuery& q) {
+    std::string text;
+    for (char c : q.text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (std::isspace(u)) {
+            if (!text.empty() && text.back() != ' ') text += ' ';
+        } else {
+            text += static_cast<char>(std::tolower(u));
+        }
+    }
+    if (!text.empty() && text.back() == ' ') text.pop_back();
+
+    return std::to_string(static_cast<int>(q.backend)) + '|' +
+           std::to_string(q.fields) + '|' +
+           std::to_string(q.maxEdits) + '|' +
+           std::to_string(q.limit) + '|' +
+           q.cursor + '|' + text;
+}
+
+// One extra hit is fetched past the page so we know whether to hand out a
+// cursor. BM25 relevance is reported as an integer (score x 1000) so every
+// backend fits SearchResult::relevanceScore.
+SearchPage LibraryEngine::search(const SearchQuery& query) {
+    std::string key = cacheKey(query);
+    CachedPage cached;
+
+    if (!searchCache.lookup(key, rankGeneration, cached)) {
+        cached = computePage(query);
+        searchCache.store(key, rankGeneration, cached);
+    }
+
+    SearchPage page;
+    page.nextCursor = cached.nextCursor;
+    for (const auto& d : cached.hits) {
+        SearchResult r = toSearchResult(docTable[d.docID]);
+        if (query.backend == SearchBackend::BM25)
+            r.relevanceScore = std::llround(d.score * 1000);
+        page.results.push_back(r);
+    }
+    return page;
+}
+
+CachedPage LibraryEngine::computePage(const SearchQuery& query) {
+    bool hasCursor = !query.cursor.empty();
+    ScoredDoc after{ 0, 0 };
+    if (hasCursor) after = decodeCursor(query.cursor);
+
+    size_t want = query.limit ? query.limit + 1 : 0;
+    std::vector<ScoredDoc> hits;
+
+    if (query.backend == SearchBackend::BM25) {
+        hits = rankedIndex.search(query.text, query.fields, want, hasCursor ? &after : nullptr);
+    } else {
+        std::vector<uint32_t> ids;
+
+        if (query.backend == SearchBackend::SUBSTRING) {
+            ids = substringIndex.find(query.text, query.fields);
+        } else {
+            AdaptiveTrie& trie = (query.fields == FIELD_AUTHOR) ? authorTrie : titleTrie;
+            std::vector<std::string> tokens = tokenize(query.text);
+
+            // A first page for one exact word comes from the trie's top-K lists.
+            if (tokens.size() == 1 && query.maxEdits <= 0 && !hasCursor &&
+                want > 0 && want <= AdaptiveTrie::TOP_K)
+                ids = trie.searchPrefix(tokens[0], want);
+            else
+                ids = matchField(trie, tokens, query.maxEdits);
+        }
 
-        std::istringstream ts(b->title), as(b->author);
-        std::string word;
+        hits = scoreByImpact(ids);
+        if (hasCursor) {
+            hits.erase(std::remove_if(hits.begin(), hits.end(),
+                [&after](const ScoredDoc& d) { return !rankedBefore(after, d); }),
+                hits.end());
+        }
+        selectTop(hits, want);
+    }
 
-        while (ts >> word) titleTrie.insert(word, b->isbn);
-        while (as >> word) authorTrie.insert(word, b->isbn);
+    CachedPage page;
+    if (query.limit && hits.size() > query.limit) {
+        hits.resize(query.limit);
+        page.nextCursor = encodeCursor(hits.back());
     }
+    page.hits.swap(hits);
+    return page;
 }
 
-std::vector<SearchResult> LibraryEngine::searchByTitle(const std::string& query) {
-    return titleTrie.searchPrefix(query, books);
+json LibraryEngine::getCacheStats() {
+    uint64_t lookups = searchCache.hitCount() + searchCache.missCount();
+    return {
+        {"success", true},
+        {"entries", searchCache.size()},
+        {"capacity", searchCache.capacity()},
+        {"hits", searchCache.hitCount()},
+        {"misses", searchCache.missCount()},
+        {"stale", searchCache.staleCount()},
+        {"evictions", searchCache.evictionCount()},
+        {"hitRate", lookups ? double(searchCache.hitCount()) / lookups : 0.0},
+        {"generation", rankGeneration}
+    };
+}
+
+std::vector<SearchResult> LibraryEngine::searchByTitle(
+    const std::string& query, size_t limit, int maxEdits
+) {
+    SearchQuery q;
+    q.text = query;
+    q.limit = limit;
+    q.maxEdits = maxEdits;
+    return search(q).results;
 }
 
-std::vector<SearchResult> LibraryEngine::searchByAuthor(const std::string& query) {
-    return authorTrie.searchPrefix(query, books);
+std::vector<SearchResult> LibraryEngine::searchByAuthor(
+    const std::string& query, size_t limit, int maxEdits
+) {
+    SearchQuery q;
+    q.text = query;
+    q.fields = FIELD_AUTHOR;
+    q.limit = limit;
+    q.maxEdits = maxEdits;
+    return search(q).results;
 }
 
 /* ================= RECOMMENDATIONS ================= */
@@ -81,7 +496,9 @@ void LibraryEngine::buildRecommendationGraph() {
 std::vector<SearchResult> LibraryEngine::getRecommendations(
     const std::string& isbn, int limit
 ) {
-    return recommendations.getRecommendations(isbn, limit, books);
+    ISBN key;
+    if (!ISBN::parse(isbn, key)) return std::vector<SearchResult>();
+    return recommendations.getRecommendations(key, limit, books);
 }
 
 std::vector<SearchResult> LibraryEngine::getPersonalizedRecommendations(
@@ -89,31 +506,15 @@ std::vector<SearchResult> LibraryEngine::getPersonalizedRecommendations(
     const std::vector<std::string>& recentISBNs,
     int limit
 ) {
-    std::vector<std::string> seeds;
-    std::unordered_set<std::string> seedSet;
-    std::unordered_set<std::string> excludeSet;
-
-    // Get borrowed + recent activity ISBNs (same logic as getUserProfile)
-    std::map<std::string, bool> borrowedBooks;
-    std::vector<Transaction*> allTransactions;
-    std::stack<Transaction*> tempStack = transactionHistory;
-    while (!tempStack.empty()) {
-        allTransactions.push_back(tempStack.top());
-        tempStack.pop();
-    }
-
-    for (auto it = allTransactions.rbegin(); it != allTransactions.rend(); ++it) {
-        Transaction* t = *it;
-        if (t->userID != userID) continue;
-
-        if (t->type == TransactionType::ISSUE) {
-            borrowedBooks[t->bookID] = true;
-            excludeSet.insert(t->bookID);
-            if (seedSet.insert(t->bookID).second)
-                seeds.push_back(t->bookID);
-        } else if (t->type == TransactionType::RETURN) {
-            if (borrowedBooks.find(t->bookID) != borrowedBooks.end())
-                borrowedBooks[t->bookID] = false;
+    std::vector<ISBN> seeds;
+    std::unordered_set<ISBN> seedSet;
+    std::unordered_set<ISBN> excludeSet;
+
+    // Everything the user has borrowed or returned seeds the walk and is
+    // excluded from the results, oldest first.
+    auto history = userHistories.find(userID);
+    if (history != userHistories.end()) {
+        for (const Transaction* t : history->second.transactions) {
             excludeSet.insert(t->bookID);
             if (seedSet.insert(t->bookID).second)
                 seeds.push_back(t->bookID);
@@ -122,14 +523,15 @@ std::vector<SearchResult> LibraryEngine::getPersonalizedRecommendations(
 
     // Add recentISBNs from frontend (searched/viewed books)
     for (const auto& isbn : recentISBNs) {
-        if (getBook(isbn) && seedSet.insert(isbn).second)
-            seeds.push_back(isbn);
+        Book* book = getBook(isbn);
+        if (book && seedSet.insert(book->isbn).second)
+            seeds.push_back(book->isbn);
     }
 
     // Collect recommendations from each seed
-    std::unordered_map<std::string, SearchResult> resultMap;
+    std::unordered_map<ISBN, SearchResult> resultMap;
     for (const auto& seed : seeds) {
-        auto recs = getRecommendations(seed, limit * 2);
+        auto recs = recommendations.getRecommendations(seed, limit * 2, books);
         for (const auto& r : recs) {
             if (excludeSet.count(r.isbn) || seedSet.count(r.isbn)) continue;
             auto it = resultMap.find(r.isbn);
@@ -140,10 +542,7 @@ std::vector<SearchResult> LibraryEngine::getPersonalizedRecommendations(
 
     std::vector<SearchResult> results;
     for (auto& p : resultMap) results.push_back(p.second);
-    std::sort(results.begin(), results.end(),
-        [](const SearchResult& a, const SearchResult& b) {
-            return a.relevanceScore > b.relevanceScore;
-        });
+    std::sort(results.begin(), results.end(), recommendedBefore);
     if ((int)results.size() > limit) results.resize(limit);
     return results;
 }
@@ -161,28 +560,44 @@ json LibraryEngine::issueBook(const std::string& userID, const std::string& isbn
         return res;
     }
 
-    if (book->availableCopies == 0) {
+    // A copy held for this user comes off the hold shelf instead.
+    Hold* hold = findHold(userID, book->isbn);
+    if (!hold && book->availableCopies == 0) {
         res["success"] = false;
         res["message"] = "No copies available";
         return res;
     }
 
-    book->availableCopies--;
+    long long when = now();
+    logOperation(JournalOp::ISSUE, userID, isbn, when);
+
+    int copy;
+    if (hold) {
+        copy = hold->copy;
+        releaseHold(hold);
+    } else {
+        copy = book->takeCopy();
+    }
 
     Transaction* t = new Transaction(
         "TXN_" + std::to_string(transactionCounter++),
         userID,
-        isbn,
-        "",                     // ✅ FIX: copyID placeholder
+        book->isbn,
+        book->copyID(copy),
         TransactionType::ISSUE
     );
+    t->timestamp = when;
+    t->pickedUp = hold;         // kept so an undo can put it back on the shelf
 
-    transactionHistory.push(t);
+    pushTransaction(t);
 
-    titleTrie.updateBorrowImpact(book->title, 1.0);
-    authorTrie.updateBorrowImpact(book->author, 1.0);
     book->borrowImpact++;
 
+    for (const auto& word : tokenize(book->title)) titleTrie.updateBorrowImpact(word, book->docID);
+    for (const auto& word : tokenize(book->author)) authorTrie.updateBorrowImpact(word, book->docID);
+    rankedIndex.updateBorrowImpact(book->docID);
+    rankGeneration++;
+
     res["success"] = true;
     res["message"] = "Book issued successfully";
     res["availableCopies"] = book->availableCopies;
@@ -193,30 +608,152 @@ json LibraryEngine::returnBook(const std::string& userID, const std::string& isb
     json res;
     Book* book = getBook(isbn);
 
-    if (!book || book->availableCopies == book->totalCopies) {
+    int copy = book ? loanedCopy(userID, book) : -1;
+
+    if (copy < 0) {
         res["success"] = false;
         res["message"] = "Invalid return";
         return res;
     }
 
-    book->availableCopies++;
+    long long when = now();
+    logOperation(JournalOp::RETURN, userID, isbn, when);
 
     Transaction* t = new Transaction(
         "TXN_" + std::to_string(transactionCounter++),
         userID,
-        isbn,
-        "",                     // ✅ FIX: copyID placeholder
+        book->isbn,
+        book->copyID(copy),
         TransactionType::RETURN
     );
+    t->timestamp = when;
 
-    transactionHistory.push(t);
+    pushTransaction(t);
+
+    Hold* hold = placeHold(book, t->transactionID, copy, when);
 
     res["success"] = true;
     res["message"] = "Book returned successfully";
     res["availableCopies"] = book->availableCopies;
+    if (hold) {
+        res["heldFor"] = hold->reservation->userID;
+        res["holdExpiresAt"] = hold->expiresAt;
+    }
     return res;
 }
 
+// The copy a return hands back: the user's latest issue of the book whose
+// copy is still out, else the lowest copy on loan to anyone (older
+// histories carry no copy IDs); -1 if no copy is on loan.
+int LibraryEngine::loanedCopy(const std::string& userID, const Book* book) const {
+    auto found = userHistories.find(userID);
+    if (found != userHistories.end()) {
+        std::vector<int> returned;
+        const std::vector<Transaction*>& mine = found->second.transactions;
+        for (auto it = mine.rbegin(); it != mine.rend(); ++it) {
+            if ((*it)->bookID != book->isbn) continue;
+            int k = book->copyNumber((*it)->copyID);
+            if (k < 0) continue;
+            if ((*it)->type == TransactionType::RETURN) {
+                returned.push_back(k);
+            } else if (std::find(returned.begin(), returned.end(), k) == returned.end() &&
+                       book->isOut(k) && !isHeld(book, k)) {
+                return k;
+            }
+        }
+    }
+    return firstLoanedCopy(book);
+}
+
+int LibraryEngine::firstLoanedCopy(const Book* book) const {
+    for (uint32_t k = 0; k < book->copySlots; k++)
+        if (book->isOut(k) && !isHeld(book, k)) return static_cast<int>(k);
+    return -1;
+}
+
+/* ================= HOLD SHELF ================= */
+
+// Gives a freed copy to the head of the book's reservation queue, or back
+// to the shelf if nobody is waiting.
+Hold* LibraryEngine::placeHold(Book* book, const std::string& holdID, int copy, long long when) {
+    auto q = reservationQueues.find(book->isbn);
+    if (q == reservationQueues.end()) {
+        book->shelveCopy(copy);
+        return nullptr;
+    }
+
+    Reservation* r = q->second.top();
+    dropReservation(r);
+
+    Hold* h = new Hold{ holdID, r, copy, when + HOLD_SECONDS, 0 };
+    addHold(h);
+    return h;
+}
+
+void LibraryEngine::addHold(Hold* h) {
+    h->timer = ++holdSerial;
+    holdsByBook[h->reservation->bookID].push_back(h);
+    holdsByTimer[h->timer] = h;
+    holdTimers.schedule(h->timer, h->expiresAt);
+}
+
+// Unlinks h from the shelf and the wheel; the caller deletes it.
+void LibraryEngine::releaseHold(Hold* h) {
+    holdTimers.cancel(h->timer);
+    holdsByTimer.erase(h->timer);
+
+    auto shelf = holdsByBook.find(h->reservation->bookID);
+    std::vector<Hold*>& held = shelf->second;
+    held.erase(std::find(held.begin(), held.end(), h));
+    if (held.empty()) holdsByBook.erase(shelf);
+}
+
+void LibraryEngine::expireHold(Hold* h) {
+    long long when = now();
+    logOperation(JournalOp::EXPIRE, h->reservation->userID, h->reservation->bookID.str(), when);
+
+    releaseHold(h);
+    Book* book = getBook(h->reservation->bookID);
+    if (book) placeHold(book, h->holdID, h->copy, when);
+
+    deleteHold(h);
+}
+
+void LibraryEngine::deleteHold(Hold* h) {
+    delete h->reservation;
+    delete h;
+}
+
+Hold* LibraryEngine::findHold(const std::string& userID, const ISBN& isbn) const {
+    auto shelf = holdsByBook.find(isbn);
+    if (shelf == holdsByBook.end()) return nullptr;
+    for (Hold* h : shelf->second)
+        if (h->reservation->userID == userID) return h;
+    return nullptr;
+}
+
+bool LibraryEngine::isHeld(const Book* book, int copy) const {
+    auto shelf = holdsByBook.find(book->isbn);
+    if (shelf == holdsByBook.end()) return false;
+    for (const Hold* h : shelf->second)
+        if (h->copy == copy) return true;
+    return false;
+}
+
+size_t LibraryEngine::expireHolds() {
+    std::vector<uint64_t> fired;
+    holdTimers.advance(time(nullptr), fired);
+
+    size_t expired = 0;
+    for (uint64_t timer : fired) {
+        auto it = holdsByTimer.find(timer);
+        if (it == holdsByTimer.end()) continue;
+        expireHold(it->second);
+        expired++;
+    }
+    return expired;
+}
+
 /* ================= RESERVATION ================= */
 
 json LibraryEngine::reserveBook(const std::string& userID, const std::string& isbn) {
@@ -230,21 +767,103 @@ json LibraryEngine::reserveBook(const std::string& userID, const std::string& is
         return res;
     }
 
+    long long when = now();
+    logOperation(JournalOp::RESERVE, userID, isbn, when);
+
     Reservation* r = new Reservation(
         "RES_" + std::to_string(reservationCounter++),
         userID,
-        isbn,
+        book->isbn,
         user->type
     );
+    r->timestamp = when;
 
-    reservationQueues[isbn].push(r);
+    queueReservation(r);
 
     res["success"] = true;
     res["message"] = "Book reserved successfully";
-    res["queuePosition"] = reservationQueues[isbn].size();
+    res["queuePosition"] = reservationQueues[book->isbn].position(r);
+    return res;
+}
+
+json LibraryEngine::cancelReservation(const std::string& userID, const std::string& isbn) {
+    json res;
+    ISBN key;
+    ISBN::parse(isbn, key);
+    Reservation* r = findReservation(userID, key);
+
+    if (!r) {
+        res["success"] = false;
+        res["message"] = "No reservation to cancel";
+        return res;
+    }
+
+    logOperation(JournalOp::CANCEL, userID, isbn, now());
+
+    dropReservation(r);
+    delete r;
+
+    res["success"] = true;
+    res["message"] = "Reservation cancelled";
+    return res;
+}
+
+json LibraryEngine::reservationPosition(const std::string& userID, const std::string& isbn) {
+    json res;
+    ISBN key;
+    ISBN::parse(isbn, key);
+
+    Hold* hold = findHold(userID, key);
+    if (hold) {
+        res["success"] = true;
+        res["reservationID"] = hold->reservation->reservationID;
+        res["queuePosition"] = 0;
+        res["readyForPickup"] = true;
+        res["holdExpiresAt"] = hold->expiresAt;
+        return res;
+    }
+
+    Reservation* r = findReservation(userID, key);
+
+    if (!r) {
+        res["success"] = false;
+        res["message"] = "No reservation found";
+        return res;
+    }
+
+    const ReservationQueue& queue = reservationQueues.at(key);
+    res["success"] = true;
+    res["reservationID"] = r->reservationID;
+    res["queuePosition"] = queue.position(r);
+    res["queueLength"] = queue.size();
     return res;
 }
 
+void LibraryEngine::queueReservation(Reservation* r) {
+    reservationQueues[r->bookID].push(r);
+    userReservations[r->userID].push_back(r);
+}
+
+// Unlinks r from both indexes; the caller deletes it.
+void LibraryEngine::dropReservation(Reservation* r) {
+    auto q = reservationQueues.find(r->bookID);
+    q->second.erase(r);
+    if (q->second.empty()) reservationQueues.erase(q);
+
+    auto u = userReservations.find(r->userID);
+    std::vector<Reservation*>& mine = u->second;
+    mine.erase(std::find(mine.begin(), mine.end(), r));
+    if (mine.empty()) userReservations.erase(u);
+}
+
+Reservation* LibraryEngine::findReservation(const std::string& userID, const ISBN& isbn) const {
+    auto u = userReservations.find(userID);
+    if (u == userReservations.end()) return nullptr;
+    for (auto it = u->second.rbegin(); it != u->second.rend(); ++it)
+        if ((*it)->bookID == isbn) return *it;
+    return nullptr;
+}
+
 /* ================= UNDO ================= */
 
 json LibraryEngine::undoLastAction() {
@@ -256,24 +875,232 @@ json LibraryEngine::undoLastAction() {
         return res;
     }
 
-    Transaction* t = transactionHistory.top();
-    transactionHistory.pop();
+    logOperation(JournalOp::UNDO, "", "", now());
+
+    Transaction* t = popTransaction();
+
+    // A return that left its copy on the hold shelf takes it back from
+    // there, and the reservation rejoins its queue.
+    Hold* hold = nullptr;
+    auto shelf = holdsByBook.find(t->bookID);
+    if (t->type == TransactionType::RETURN && shelf != holdsByBook.end()) {
+        for (Hold* h : shelf->second)
+            if (h->holdID == t->transactionID) hold = h;
+    }
 
     Book* book = getBook(t->bookID);
-    if (book) {
-        if (t->type == TransactionType::ISSUE)
-            book->availableCopies++;
-        else
-            book->availableCopies--;
+    if (hold) {
+        releaseHold(hold);
+        queueReservation(hold->reservation);
+        delete hold;
+    } else if (t->pickedUp) {
+        // An issue from the hold shelf returns the copy there, under the
+        // return's hold ID, so undoing that return still finds it.
+        if (book) addHold(t->pickedUp);
+        else deleteHold(t->pickedUp);
+        t->pickedUp = nullptr;
+    } else if (book) {
+        // The transaction's own copy where possible; transactions from
+        // before copies were tracked carry no copy ID.
+        int copy = book->copyNumber(t->copyID);
+        if (t->type == TransactionType::ISSUE) {
+            if (!book->isOut(copy) || isHeld(book, copy)) copy = firstLoanedCopy(book);
+            book->shelveCopy(copy);
+        } else if (!book->takeCopy(copy)) {
+            book->takeCopy();
+        }
     }
 
-    delete t;
+    deleteTransaction(t);
 
     res["success"] = true;
     res["message"] = "Undo successful";
     return res;
 }
 
+/* ================= TRANSACTION HISTORY ================= */
+
+void LibraryEngine::pushTransaction(Transaction* t) {
+    transactionHistory.push(t);
+
+    UserHistory& history = userHistories[t->userID];
+    history.transactions.push_back(t);
+    if (t->type == TransactionType::RETURN)
+        clearLoan(t->userID, history, t->bookID);
+    else if (!history.activeLoans.count(t->bookID))     // a repeat issue keeps the loan's start
+        setLoan(t->userID, history, t->bookID, t->timestamp);
+}
+
+void LibraryEngine::deleteTransaction(Transaction* t) {
+    if (t->pickedUp) deleteHold(t->pickedUp);
+    delete t;
+}
+
+Transaction* LibraryEngine::popTransaction() {
+    Transaction* t = transactionHistory.top();
+    transactionHistory.pop();
+
+    // The newest transaction overall is also its user's newest.
+    auto it = userHistories.find(t->userID);
+    it->second.transactions.pop_back();
+    refreshLoan(t->userID, it->second, t->bookID);
+    if (it->second.transactions.empty()) userHistories.erase(it);
+    return t;
+}
+
+// Recomputes whether isbn is on loan from the user's remaining history: it
+// is if their latest transaction for it is an issue, dated from the first
+// issue of that unbroken run.
+void LibraryEngine::refreshLoan(const std::string& userID, UserHistory& history,
+                                const ISBN& isbn) {
+    long long issued = 0;
+    bool onLoan = false;
+    for (auto it = history.transactions.rbegin(); it != history.transactions.rend(); ++it) {
+        if ((*it)->bookID != isbn) continue;
+        if ((*it)->type == TransactionType::RETURN) break;
+        onLoan = true;
+        issued = (*it)->timestamp;
+    }
+
+    if (onLoan) setLoan(userID, history, isbn, issued);
+    else clearLoan(userID, history, isbn);
+}
+
+void LibraryEngine::setLoan(const std::string& userID, UserHistory& history,
+                            const ISBN& isbn, long long issued) {
+    clearLoan(userID, history, isbn);
+    history.activeLoans[isbn] = issued;
+    dueIndex.insert({ issued + LOAN_SECONDS, userID, isbn });
+}
+
+void LibraryEngine::clearLoan(const std::string& userID, UserHistory& history,
+                              const ISBN& isbn) {
+    auto loan = history.activeLoans.find(isbn);
+    if (loan == history.activeLoans.end()) return;
+    dueIndex.erase({ loan->second + LOAN_SECONDS, userID, isbn });
+    history.activeLoans.erase(loan);
+}
+
+/* ================= DUE DATES ================= */
+
+// Cursors are the last loan of a page: its due date as 16 hex digits, the
+// user ID preceded by its length as 4 hex digits, then the ISBN's number
+// as 16 hex digits.
+static std::string encodeDueCursor(long long dueDate, const std::string& userID,
+                                   const ISBN& isbn) {
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "%016llx%04x", static_cast<unsigned long long>(dueDate),
+                  static_cast<unsigned>(userID.size() & 0xffff));
+    std::string cursor = buf + userID;
+    std::snprintf(buf, sizeof buf, "%016llx", static_cast<unsigned long long>(isbn.id()));
+    return cursor + buf;
+}
+
+static void decodeDueCursor(const std::string& cursor, long long& dueDate,
+                            std::string& userID, ISBN& isbn) {
+    auto hex = [&cursor](size_t pos, size_t len) {
+        if (pos + len > cursor.size() ||
+            cursor.find_first_not_of("0123456789abcdef", pos) < pos + len)
+            throw std::invalid_argument("Invalid cursor");
+        return std::stoull(cursor.substr(pos, len), nullptr, 16);
+    };
+
+    dueDate = static_cast<long long>(hex(0, 16));
+    size_t pos = 20, length = hex(16, 4);
+    if (pos + length > cursor.size()) throw std::invalid_argument("Invalid cursor");
+    userID = cursor.substr(pos, length);
+    pos += length;
+    if (pos + 16 != cursor.size()) throw std::invalid_argument("Invalid cursor");
+    isbn = ISBN(hex(pos, 16) & ISBN::ID_MASK);
+}
+
+json LibraryEngine::loansDue(long long from, long long until, size_t limit,
+                             const std::string& cursor) {
+    auto it = dueIndex.lower_bound({ from, "", ISBN() });
+    if (!cursor.empty()) {
+        DueEntry after;
+        decodeDueCursor(cursor, after.dueDate, after.userID, after.isbn);
+        if (after.dueDate >= from) it = dueIndex.upper_bound(after);
+    }
+
+    json res;
+    res["success"] = true;
+    res["loans"] = json::array();
+
+    size_t count = 0;
+    for (; it != dueIndex.end() && it->dueDate <= until; ++it) {
+        if (limit > 0 && count == limit) {
+            auto last = std::prev(it);
+            res["nextCursor"] = encodeDueCursor(last->dueDate, last->userID, last->isbn);
+            break;
+        }
+
+        const User* user = getUser(it->userID);
+        const Book* book = getBook(it->isbn);
+        res["loans"].push_back({
+            {"userID", it->userID},
+            {"name", user ? user->name : ""},
+            {"email", user ? user->email : ""},
+            {"isbn", book ? book->isbn.str() : it->isbn.str()},
+            {"title", book ? book->title : ""},
+            {"issueDate", it->dueDate - LOAN_SECONDS},
+            {"dueDate", it->dueDate}
+        });
+        count++;
+    }
+    res["count"] = count;
+    return res;
+}
+
+/* ================= ISBN BROWSE ================= */
+
+// Cursors are the number of the last ISBN on the page as 16 hex digits.
+json LibraryEngine::browseISBN(const std::string& prefix, size_t limit,
+                               const std::string& cursor) {
+    json res;
+    uint64_t first, last;
+    if (!ISBN::prefixRange(prefix, first, last)) {
+        res["success"] = false;
+        res["message"] = "Invalid ISBN prefix";
+        return res;
+    }
+
+    if (!cursor.empty()) {
+        if (cursor.size() != 16 || cursor.find_first_not_of("0123456789abcdef") != std::string::npos)
+            throw std::invalid_argument("Invalid cursor");
+        first = std::max<uint64_t>(first, (std::stoull(cursor, nullptr, 16) & ISBN::ID_MASK) + 1);
+    }
+
+    res["success"] = true;
+    res["books"] = json::array();
+
+    auto range = bookISBNIndex.range(first, last);
+    size_t count = 0;
+    for (auto it = range.first; it != range.second; ++it) {
+        if (limit > 0 && count == limit) {
+            --it;
+            char buf[17];
+            std::snprintf(buf, sizeof buf, "%016llx",
+                          static_cast<unsigned long long>((*it)->isbn.id()));
+            res["nextCursor"] = buf;
+            break;
+        }
+
+        const Book* b = *it;
+        res["books"].push_back({
+            {"isbn", b->isbn.str()},
+            {"title", b->title},
+            {"author", b->author},
+            {"category", b->category},
+            {"availableCopies", b->availableCopies},
+            {"totalCopies", b->totalCopies}
+        });
+        count++;
+    }
+    res["count"] = count;
+    return res;
+}
+
 /* ================= PROFILE ================= */
 
 json LibraryEngine::getUserProfile(const std::string& userID) {
@@ -296,114 +1123,73 @@ json LibraryEngine::getUserProfile(const std::string& userID) {
         {"registrationDate", user->registrationDate}
     };
 
-    // Calculate statistics by analyzing transaction history
+    static const UserHistory noHistory;
+    auto found = userHistories.find(userID);
+    const UserHistory& history = found != userHistories.end() ? found->second : noHistory;
+
+    // Calculate statistics from the user's own transactions, oldest first
     int totalBorrowed = 0;
     int activeBorrows = 0;
     int reservations = 0;
-    std::map<std::string, bool> borrowedBooks; // ISBN -> isActive
-    
-    // Create a copy of transaction history to iterate (stack doesn't support iteration)
-    std::vector<Transaction*> allTransactions;
-    std::stack<Transaction*> tempStack = transactionHistory;
-    while (!tempStack.empty()) {
-        allTransactions.push_back(tempStack.top());
-        tempStack.pop();
-    }
-
-    // Process transactions in reverse chronological order
-    for (auto it = allTransactions.rbegin(); it != allTransactions.rend(); ++it) {
-        Transaction* t = *it;
-        if (t->userID != userID) continue;
+    std::unordered_set<ISBN> issued;
 
+    for (const Transaction* t : history.transactions) {
         if (t->type == TransactionType::ISSUE) {
             totalBorrowed++;
-            borrowedBooks[t->bookID] = true;
             activeBorrows++;
-        } else if (t->type == TransactionType::RETURN) {
-            if (borrowedBooks.find(t->bookID) != borrowedBooks.end()) {
-                borrowedBooks[t->bookID] = false;
-                activeBorrows--;
-            }
+            issued.insert(t->bookID);
+        } else if (issued.count(t->bookID)) {
+            activeBorrows--;
         }
     }
 
-    // Count reservations
-    for (auto& queuePair : reservationQueues) {
-        std::priority_queue<Reservation*, std::vector<Reservation*>, ReservationCompare> tempQueue = queuePair.second;
-        while (!tempQueue.empty()) {
-            if (tempQueue.top()->userID == userID) {
-                reservations++;
-                break;
-            }
-            tempQueue.pop();
-        }
+    // Count reserved books
+    auto reserved = userReservations.find(userID);
+    if (reserved != userReservations.end()) {
+        std::unordered_set<ISBN> reservedBooks;
+        for (const Reservation* r : reserved->second)
+            if (reservedBooks.insert(r->bookID).second) reservations++;
     }
 
     // Get currently borrowed books with details
     res["borrowedBooks"] = json::array();
-    for (auto& pair : borrowedBooks) {
-        if (pair.second) { // Only active borrows
-            Book* book = getBook(pair.first);
-            if (book) {
-                // Find the issue transaction for this book
-                long long issueDate = 0;
-                for (auto it = allTransactions.rbegin(); it != allTransactions.rend(); ++it) {
-                    Transaction* t = *it;
-                    if (t->userID == userID && t->bookID == pair.first && t->type == TransactionType::ISSUE) {
-                        issueDate = t->timestamp;
-                        break;
-                    }
-                }
-                
-                // Calculate due date (14 days from issue)
-                long long dueDate = issueDate + (14 * 24 * 60 * 60);
-                long long now = time(nullptr);
-                std::string status = "on_time";
-                if (now > dueDate) status = "overdue";
-                else if ((dueDate - now) < (3 * 24 * 60 * 60)) status = "due_soon";
-
-                res["borrowedBooks"].push_back({
-                    {"isbn", book->isbn},
-                    {"title", book->title},
-                    {"author", book->author},
-                    {"category", book->category},
-                    {"issueDate", issueDate},
-                    {"dueDate", dueDate},
-                    {"status", status}
-                });
-            }
-        }
+    for (const auto& loan : history.activeLoans) {
+        Book* book = getBook(loan.first);
+        if (!book) continue;
+
+        // Calculate due date (14 days from issue)
+        long long issueDate = loan.second;
+        long long dueDate = issueDate + LOAN_SECONDS;
+        long long now = time(nullptr);
+        std::string status = "on_time";
+        if (now > dueDate) status = "overdue";
+        else if ((dueDate - now) < (3 * 24 * 60 * 60)) status = "due_soon";
+
+        res["borrowedBooks"].push_back({
+            {"isbn", book->isbn.str()},
+            {"title", book->title},
+            {"author", book->author},
+            {"category", book->category},
+            {"issueDate", issueDate},
+            {"dueDate", dueDate},
+            {"status", status}
+        });
     }
 
     // Get recent activity (last 10 transactions) - newest first
-    std::vector<std::pair<Transaction*, Book*>> userActivities;
-    for (auto* t : allTransactions) {
-        if (t->userID != userID) continue;
-        Book* book = getBook(t->bookID);
-        if (book) {
-            userActivities.push_back({t, book});
-        }
-    }
-    
-    // Sort by timestamp descending (newest first)
-    std::sort(userActivities.begin(), userActivities.end(),
-        [](const std::pair<Transaction*, Book*>& a, const std::pair<Transaction*, Book*>& b) {
-            return a.first->timestamp > b.first->timestamp;
-        });
-    
-    // Take only the 10 most recent
     res["activity"] = json::array();
     int count = 0;
-    for (auto& pair : userActivities) {
-        if (count >= 10) break;
-        Transaction* t = pair.first;
-        Book* book = pair.second;
-        
+    for (auto it = history.transactions.rbegin(); it != history.transactions.rend() && count < 10; ++it) {
+        const Transaction* t = *it;
+        Book* book = getBook(t->bookID);
+        if (!book) continue;
+
         res["activity"].push_back({
             {"type", t->type == TransactionType::ISSUE ? "issue" : "return"},
-            {"isbn", book->isbn},
+            {"isbn", book->isbn.str()},
             {"title", book->title},
             {"author", book->author},
+            {"copyID", t->copyID},
             {"timestamp", t->timestamp}
         });
         count++;
@@ -419,4 +1205,531 @@ json LibraryEngine::getUserProfile(const std::string& userID) {
 
     res["success"] = true;
     return res;
-}
\ No newline at end of file
+}
+/* ================= SNAPSHOT ================= */
+
+namespace {
+
+// Offset and length of a string in the SNAP_STRINGS pool.
+struct PoolString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Removed books keep their slot (live = 0) so doc IDs stay stable across
+// a restart. A book's copy bitmaps sit at copyOffset in SNAP_COPIES: its
+// shelf words, then its withdrawn words.
+struct BookRecord {
+    uint64_t isbn;                  // ISBN::packed
+    PoolString title, author, category;
+    int32_t totalCopies;
+    int32_t availableCopies;
+    uint32_t live;
+    uint32_t copySlots;
+    int64_t borrowImpact;
+    uint64_t copyOffset;
+};
+
+// pickedUp is 1 + the index of the issue's hold in the picked-up holds
+// array, or 0.
+struct TransactionRecord {
+    PoolString transactionID, userID, copyID;
+    uint64_t bookID;
+    uint32_t type;
+    uint32_t pickedUp;
+    int64_t timestamp;
+};
+
+struct UserRecord {
+    PoolString userID, name, email;
+    uint32_t type;
+    uint32_t reserved;
+    int64_t registrationDate;
+};
+
+struct ReservationRecord {
+    PoolString reservationID, userID;
+    uint64_t bookID;
+    int32_t priorityScore;
+    uint32_t reserved;
+    int64_t timestamp;
+};
+
+struct HoldRecord {
+    PoolString holdID, reservationID, userID;
+    uint64_t bookID;
+    int32_t priorityScore;
+    int32_t copy;
+    int64_t reservedAt;
+    int64_t expiresAt;
+};
+
+// Circulation state and the journal position it reflects, so a restart
+// replays only the records written after the snapshot.
+struct CirculationHeader {
+    uint64_t journalSequence;
+    int32_t transactionCounter;
+    int32_t reservationCounter;
+};
+
+class StringPool {
+private:
+    std::string data;
+
+public:
+    PoolString add(const std::string& s) {
+        PoolString p = { static_cast<uint32_t>(data.size()), static_cast<uint32_t>(s.size()) };
+        data += s;
+        return p;
+    }
+    const std::string& str() const { return data; }
+};
+
+class PoolReader {
+private:
+    const char* data;
+    size_t size;
+
+public:
+    PoolReader(const char* d, size_t n) : data(d), size(n) {}
+
+    std::string operator()(const PoolString& p) const {
+        if (p.offset > size || p.length > size - p.offset)
+            throw std::runtime_error("Snapshot string out of range");
+        return std::string(data + p.offset, p.length);
+    }
+};
+
+HoldRecord holdRecord(const Hold* h, StringPool& pool) {
+    HoldRecord r = HoldRecord();
+    r.holdID = pool.add(h->holdID);
+    r.reservationID = pool.add(h->reservation->reservationID);
+    r.userID = pool.add(h->reservation->userID);
+    r.bookID = h->reservation->bookID.packed;
+    r.priorityScore = h->reservation->priorityScore;
+    r.copy = h->copy;
+    r.reservedAt = h->reservation->timestamp;
+    r.expiresAt = h->expiresAt;
+    return r;
+}
+
+ISBN recordISBN(uint64_t packed) {
+    ISBN isbn(packed);
+    if (isbn.empty()) throw std::runtime_error("Snapshot ISBN is invalid");
+    return isbn;
+}
+
+}
+
+json LibraryEngine::saveSnapshot(const std::string& path) {
+    StringPool pool;
+
+    std::vector<BookRecord> records(docTable.size(), BookRecord());
+    std::vector<uint64_t> copyWords;
+    for (size_t k = 0; k < docTable.size(); k++) {
+        const Book* b = docTable[k];
+        if (!b) continue;
+        BookRecord& r = records[k];
+        r.isbn = b->isbn.packed;
+        r.title = pool.add(b->title);
+        r.author = pool.add(b->author);
+        r.category = pool.add(b->category);
+        r.totalCopies = b->totalCopies;
+        r.availableCopies = b->availableCopies;
+        r.live = 1;
+        r.copySlots = b->copySlots;
+        r.borrowImpact = b->borrowImpact;
+        r.copyOffset = copyWords.size();
+        copyWords.insert(copyWords.end(), b->copyShelf.begin(), b->copyShelf.end());
+        copyWords.insert(copyWords.end(), b->copyWithdrawn.begin(), b->copyWithdrawn.end());
+    }
+
+    std::vector<uint32_t> byISBN;
+    for (const Book* b : bookISBNIndex.getAllBooks())
+        byISBN.push_back(b->docID);
+
+    // Oldest transaction first, so restoring is a series of pushes.
+    std::vector<TransactionRecord> transactions;
+    std::vector<HoldRecord> pickedUp;
+    for (auto history = transactionHistory; !history.empty(); history.pop()) {
+        const Transaction* t = history.top();
+        TransactionRecord r = TransactionRecord();
+        r.transactionID = pool.add(t->transactionID);
+        r.userID = pool.add(t->userID);
+        r.bookID = t->bookID.packed;
+        r.copyID = pool.add(t->copyID);
+        r.type = static_cast<uint32_t>(t->type);
+        r.timestamp = t->timestamp;
+        if (t->pickedUp) {
+            pickedUp.push_back(holdRecord(t->pickedUp, pool));
+            r.pickedUp = static_cast<uint32_t>(pickedUp.size());
+        }
+        transactions.push_back(r);
+    }
+    std::reverse(transactions.begin(), transactions.end());
+
+    std::vector<ReservationRecord> reservations;
+    // In serving order per book, so restoring keeps ties in line.
+    for (const auto& q : reservationQueues) {
+        for (const Reservation* res : q.second.ordered()) {
+            ReservationRecord r = ReservationRecord();
+            r.reservationID = pool.add(res->reservationID);
+            r.userID = pool.add(res->userID);
+            r.bookID = res->bookID.packed;
+            r.priorityScore = res->priorityScore;
+            r.timestamp = res->timestamp;
+            reservations.push_back(r);
+        }
+    }
+
+    std::vector<HoldRecord> holds;
+    for (const auto& shelf : holdsByBook) {
+        for (const Hold* h : shelf.second)
+            holds.push_back(holdRecord(h, pool));
+    }
+
+    std::vector<UserRecord> userRecords;
+    for (const auto& u : users) {
+        UserRecord r = UserRecord();
+        r.userID = pool.add(u.second->userID);
+        r.name = pool.add(u.second->name);
+        r.email = pool.add(u.second->email);
+        r.type = static_cast<uint32_t>(u.second->type);
+        r.registrationDate = u.second->registrationDate;
+        userRecords.push_back(r);
+    }
+
+    CirculationHeader circulation = CirculationHeader();
+    circulation.journalSequence = journalSequence;
+    circulation.transactionCounter = transactionCounter;
+    circulation.reservationCounter = reservationCounter;
+
+    SnapshotWriter out;
+    out.beginSection(SNAP_SOURCE);
+    out.put(catalogSource);
+    out.beginSection(SNAP_STRINGS);
+    out.putString(pool.str());
+    out.beginSection(SNAP_CATALOG);
+    out.putArray(records);
+    out.beginSection(SNAP_COPIES);
+    out.putArray(copyWords);
+    out.beginSection(SNAP_ISBN_INDEX);
+    out.putArray(byISBN);
+    out.beginSection(SNAP_TITLE_TRIE);
+    titleTrie.writeTo(out);
+    out.beginSection(SNAP_AUTHOR_TRIE);
+    authorTrie.writeTo(out);
+    out.beginSection(SNAP_SUBSTRING);
+    substringIndex.writeTo(out);
+    out.beginSection(SNAP_GRAPH);
+    recommendations.writeTo(out, books);
+    out.beginSection(SNAP_USERS);
+    out.putArray(userRecords);
+    out.beginSection(SNAP_CIRCULATION);
+    out.put(circulation);
+    out.putArray(transactions);
+    out.putArray(reservations);
+    out.putArray(holds);
+    out.putArray(pickedUp);
+    out.commit(path);
+
+    json res;
+    res["success"] = true;
+    res["message"] = "Snapshot written";
+    res["books"] = books.size();
+    res["journalSequence"] = journalSequence;
+    return res;
+}
+
+void LibraryEngine::setCatalogSource(uint64_t fingerprint) {
+    catalogSource = fingerprint;
+}
+
+std::vector<std::string> LibraryEngine::loadSnapshot(const std::string& path, bool withCatalog) {
+    std::vector<std::string> warnings;
+    MappedFile file(path);
+    SnapshotReader snap(file);
+
+    uint64_t source = snap.section(SNAP_SOURCE).get<uint64_t>();
+    if (withCatalog && catalogSource != 0 && source != catalogSource)
+        throw std::runtime_error("Snapshot catalog does not match books.csv");
+
+    size_t poolSize;
+    const char* poolData = snap.section(SNAP_STRINGS).array<char>(poolSize);
+    PoolReader text(poolData, poolSize);
+
+    size_t count;
+    const BookRecord* records = snap.section(SNAP_CATALOG).array<BookRecord>(count);
+
+    size_t copyCount;
+    const uint64_t* copyWords = snap.section(SNAP_COPIES).array<uint64_t>(copyCount);
+
+    auto restoreState = [&](Book* b, const BookRecord& r) {
+        uint64_t words = (static_cast<uint64_t>(r.copySlots) + 63) / 64;
+        if (r.copyOffset > copyCount || 2 * words > copyCount - r.copyOffset)
+            throw std::runtime_error("Snapshot copy state is out of range");
+        b->restoreCopies(r.copySlots, copyWords + r.copyOffset, copyWords + r.copyOffset + words);
+        b->borrowImpact = r.borrowImpact;
+    };
+
+    if (!withCatalog) {
+        // The CSV's copy count wins as far as the copies out allow.
+        for (size_t k = 0; k < count; k++) {
+            if (!records[k].live) continue;
+            Book* b = getBook(recordISBN(records[k].isbn));
+            if (!b) continue;
+            int total = b->totalCopies;
+            restoreState(b, records[k]);
+            if (!b->setTotalCopies(total)) {
+                b->setTotalCopies(b->totalCopies - b->availableCopies);
+                warnings.push_back("books.csv lists " + std::to_string(total) + " copies of " +
+                                   b->isbn.str() + " but " + std::to_string(b->totalCopies) +
+                                   " are out; keeping " + std::to_string(b->totalCopies));
+            }
+        }
+    } else {
+        docTable.assign(count, nullptr);
+        books.reserve(count);
+        for (size_t k = 0; k < count; k++) {
+            const BookRecord& r = records[k];
+            if (!r.live) continue;
+
+            Book* b = new Book(recordISBN(r.isbn), text(r.title), text(r.author), text(r.category), 0);
+            b->docID = k;
+            restoreState(b, r);
+            if (!books.emplace(b->isbn, b).second) {
+                delete b;
+                throw std::runtime_error("Snapshot has a duplicate ISBN");
+            }
+            docTable[k] = b;
+        }
+
+        size_t indexed;
+        const uint32_t* byISBN = snap.section(SNAP_ISBN_INDEX).array<uint32_t>(indexed);
+        if (indexed != books.size())
+            throw std::runtime_error("Snapshot ISBN index is inconsistent");
+
+        std::vector<Book*> sorted(indexed);
+        for (size_t k = 0; k < indexed; k++) {
+            if (byISBN[k] >= count || !docTable[byISBN[k]] ||
+                (k > 0 && !(sorted[k - 1]->isbn < docTable[byISBN[k]]->isbn)))
+                throw std::runtime_error("Snapshot ISBN index is inconsistent");
+            sorted[k] = docTable[byISBN[k]];
+        }
+        bookISBNIndex.insertSorted(sorted);
+        if (bookLookup == BookLookup::PERFECT_HASH) bookHash.build(sorted);
+
+        titleTrie.readFrom(snap.section(SNAP_TITLE_TRIE));
+        authorTrie.readFrom(snap.section(SNAP_AUTHOR_TRIE));
+        substringIndex.readFrom(snap.section(SNAP_SUBSTRING));
+        recommendations.readFrom(snap.section(SNAP_GRAPH), docTable);
+
+        // The BM25 index is cheap next to parsing, and keeps its own bounds.
+        for (Book* b : docTable)
+            if (b) rankedIndex.addDocument(b->docID);
+    }
+
+    size_t n;
+    const UserRecord* userRecords = snap.section(SNAP_USERS).array<UserRecord>(n);
+    for (size_t k = 0; k < n; k++) {
+        const UserRecord& r = userRecords[k];
+        if (r.type > static_cast<uint32_t>(UserType::FACULTY))
+            throw std::runtime_error("Snapshot user is invalid");
+        std::string id = text(r.userID);
+        if (users.count(id)) continue;
+
+        User* u = new User(id, text(r.name), text(r.email), static_cast<UserType>(r.type));
+        u->registrationDate = r.registrationDate;
+        users[id] = u;
+    }
+
+    SnapshotCursor circulationSection = snap.section(SNAP_CIRCULATION);
+    CirculationHeader circulation = circulationSection.get<CirculationHeader>();
+    journalSequence = circulation.journalSequence;
+    checkpointSequence = circulation.journalSequence;
+    transactionCounter = circulation.transactionCounter;
+    reservationCounter = circulation.reservationCounter;
+
+    const TransactionRecord* transactions = circulationSection.array<TransactionRecord>(n);
+    std::vector<std::pair<Transaction*, uint32_t>> pickups;
+    for (size_t k = 0; k < n; k++) {
+        const TransactionRecord& r = transactions[k];
+        if (r.type > static_cast<uint32_t>(TransactionType::RETURN))
+            throw std::runtime_error("Snapshot transaction is invalid");
+        Transaction* t = new Transaction(text(r.transactionID), text(r.userID), recordISBN(r.bookID),
+                                         text(r.copyID), static_cast<TransactionType>(r.type));
+        t->timestamp = r.timestamp;
+        pushTransaction(t);
+        if (r.pickedUp) pickups.emplace_back(t, r.pickedUp - 1);
+    }
+
+    // Reservations and holds for books that are no longer in the catalog
+    // are dropped.
+    size_t orphans = 0;
+    const ReservationRecord* reservations = circulationSection.array<ReservationRecord>(n);
+    for (size_t k = 0; k < n; k++) {
+        const ReservationRecord& r = reservations[k];
+        if (!getBook(recordISBN(r.bookID))) {
+            orphans++;
+            continue;
+        }
+        Reservation* res = new Reservation(text(r.reservationID), text(r.userID),
+                                           recordISBN(r.bookID), UserType::STUDENT);
+        res->priorityScore = r.priorityScore;
+        res->timestamp = r.timestamp;
+        queueReservation(res);
+    }
+
+    const HoldRecord* holds = circulationSection.array<HoldRecord>(n);
+    for (size_t k = 0; k < n; k++) {
+        const HoldRecord& r = holds[k];
+        if (!getBook(recordISBN(r.bookID))) {
+            orphans++;
+            continue;
+        }
+        Reservation* res = new Reservation(text(r.reservationID), text(r.userID),
+                                           recordISBN(r.bookID), UserType::STUDENT);
+        res->priorityScore = r.priorityScore;
+        res->timestamp = r.reservedAt;
+        addHold(new Hold{ text(r.holdID), res, r.copy, r.expiresAt, 0 });
+    }
+
+    const HoldRecord* pickedUp = circulationSection.array<HoldRecord>(n);
+    for (const auto& p : pickups) {
+        if (p.second >= n) throw std::runtime_error("Snapshot transaction is invalid");
+        const HoldRecord& r = pickedUp[p.second];
+        Reservation* res = new Reservation(text(r.reservationID), text(r.userID),
+                                           recordISBN(r.bookID), UserType::STUDENT);
+        res->priorityScore = r.priorityScore;
+        res->timestamp = r.reservedAt;
+        p.first->pickedUp = new Hold{ text(r.holdID), res, r.copy, r.expiresAt, 0 };
+    }
+
+    if (orphans > 0)
+        warnings.push_back("Dropped " + std::to_string(orphans) +
+                           " reservations and holds for books not in the catalog");
+    return warnings;
+}
+
+/* ================= CHECKPOINT ================= */
+
+json LibraryEngine::checkpoint(const std::string& path, bool background) {
+    json res;
+
+    if (checkpointPid) {
+        res["success"] = false;
+        res["message"] = "A checkpoint is already running";
+        return res;
+    }
+
+    // Records up to journalSequence are in the sealed segments below `cut`;
+    // everything after lands in the new segment and survives the cleanup.
+    uint64_t cut = journal ? journal->rotate() : 0;
+
+#ifndef _WIN32
+    if (background) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // The child owns a copy-on-write image of the engine. It must not
+            // touch the journal (its flusher thread does not exist here) or
+            // flush the parent's stdio buffers, hence _exit.
+            int status = 0;
+            try { saveSnapshot(path); }
+            catch (...) { status = 1; }
+            _exit(status);
+        }
+        if (pid > 0) {
+            checkpointPid = pid;
+            checkpointSegment = cut;
+            pendingSequence = journalSequence;
+            res["success"] = true;
+            res["message"] = "Checkpoint started";
+            res["journalSequence"] = pendingSequence;
+            return res;
+        }
+        // fork() failed: fall back to writing inline.
+    }
+#else
+    (void)background;
+#endif
+
+    res = saveSnapshot(path);
+    checkpointSequence = journalSequence;
+    if (journal) Journal::removeSegmentsBefore(journalPath, cut);
+    return res;
+}
+
+LibraryEngine::CheckpointStatus LibraryEngine::pollCheckpoint(bool wait) {
+#ifndef _WIN32
+    if (!checkpointPid) return CheckpointStatus::IDLE;
+
+    int status = 0;
+    pid_t done = waitpid(checkpointPid, &status, wait ? 0 : WNOHANG);
+    if (done == 0) return CheckpointStatus::RUNNING;
+
+    checkpointPid = 0;
+    if (done < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return CheckpointStatus::FAILED;
+
+    checkpointSequence = pendingSequence;
+    if (journal) Journal::removeSegmentsBefore(journalPath, checkpointSegment);
+    return CheckpointStatus::SUCCEEDED;
+#else
+    (void)wait;
+    return CheckpointStatus::IDLE;
+#endif
+}
+
+uint64_t LibraryEngine::journalRecordsSinceCheckpoint() const {
+    return journalSequence - checkpointSequence;
+}
+
+/* ================= JOURNAL ================= */
+
+long long LibraryEngine::now() const {
+    return replayTime ? replayTime : static_cast<long long>(time(nullptr));
+}
+
+void LibraryEngine::logOperation(
+    JournalOp op, const std::string& userID,
+    const std::string& isbn, long long when
+) {
+    if (journal)
+        journalSequence = journal->append(op, when, userID, isbn);
+}
+
+size_t LibraryEngine::openJournal(const std::string& path, const JournalOptions& options) {
+    std::vector<JournalRecord> records = Journal::recover(path);
+    size_t replayed = 0;
+
+    // Each record was journaled after its checks passed against the same
+    // state, so replaying in order reproduces it. A record can only fail
+    // if the catalog or user list changed underneath it since.
+    for (const JournalRecord& r : records) {
+        if (r.sequence <= journalSequence) continue;
+
+        replayTime = r.timestamp;
+        switch (r.op) {
+            case JournalOp::ISSUE:   issueBook(r.userID, r.isbn); break;
+            case JournalOp::RETURN:  returnBook(r.userID, r.isbn); break;
+            case JournalOp::RESERVE: reserveBook(r.userID, r.isbn); break;
+            case JournalOp::UNDO:    undoLastAction(); break;
+            case JournalOp::CANCEL:  cancelReservation(r.userID, r.isbn); break;
+            case JournalOp::EXPIRE: {
+                ISBN key;
+                Hold* h = ISBN::parse(r.isbn, key) ? findHold(r.userID, key) : nullptr;
+                if (h) expireHold(h);
+                break;
+            }
+        }
+        journalSequence = r.sequence;
+        replayed++;
+    }
+    replayTime = 0;
+
+    uint64_t next = journalSequence + 1;
+    if (!records.empty()) next = std::max<uint64_t>(next, records.back().sequence + 1);
+    journal = new Journal(path, next, options);
+    journalPath = path;
+    return replayed;
+}
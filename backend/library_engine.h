@@ -1,12 +1,22 @@
 #ifndef LIBRARY_ENGINE_H
 #define LIBRARY_ENGINE_H
 
-#include "avl_tree.h"
+#include "isbn_index.h"
+#include "perfect_hash.h"
 #include "trie.h"
+#include "inverted_index.h"
+#include "suffix_array.h"
+#include "query_cache.h"
 #include "recommendation_graph.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "reservation_queue.h"
+#include "timing_wheel.h"
 #include "models.h"
 
 #include <unordered_map>
+#include <map>
+#include <set>
 #include <queue>
 #include <stack>
 #include <vector>
@@ -14,55 +24,229 @@
 
 using json = nlohmann::json;
 
-struct ReservationCompare {
-    bool operator()(const Reservation* a, const Reservation* b) const {
-        if (a->priorityScore != b->priorityScore)
-            return a->priorityScore < b->priorityScore;
-        return a->timestamp > b->timestamp;
-    }
+enum class SearchBackend { TRIE, BM25, SUBSTRING };
+
+enum class BookLookup { ISBN_INDEX, PERFECT_HASH };
+
+struct SearchQuery {
+    std::string text;
+    unsigned fields;        // FIELD_* bits; the trie backend uses author or title
+    SearchBackend backend;
+    size_t limit;           // page size, 0 = all matches
+    std::string cursor;     // nextCursor of the previous page, or empty
+    int maxEdits;           // trie backend only
+
+    SearchQuery()
+        : fields(FIELD_TITLE), backend(SearchBackend::TRIE),
+          limit(0), maxEdits(0) {}
+};
+
+struct SearchPage {
+    std::vector<SearchResult> results;
+    std::string nextCursor;     // empty on the last page
 };
 
 class LibraryEngine {
 private:
-    AVLTree bookISBNIndex;
+    // docID -> Book*, in addBook order. Declared before the tries that
+    // reference it.
+    std::vector<Book*> docTable;
+
+    ISBNIndex bookISBNIndex;
+
+    // Optional getBook backend for the read-mostly catalog; maintained only
+    // while selected.
+    PerfectHashIndex bookHash;
+    BookLookup bookLookup;
+
     AdaptiveTrie titleTrie;
     AdaptiveTrie authorTrie;
+    InvertedIndex rankedIndex;
+    SuffixArray substringIndex;
     RecommendationGraph recommendations;
 
-    std::unordered_map<std::string, Book*> books;
+    // Search pages keyed by query shape. rankGeneration is bumped by
+    // anything that can reorder or change the hit set (borrows today);
+    // availability is read fresh when a cached page is materialized.
+    QueryCache searchCache;
+    uint64_t rankGeneration;
+
+    std::unordered_map<ISBN, Book*> books;
     std::unordered_map<std::string, User*> users;
 
-    std::unordered_map<
-        std::string,
-        std::priority_queue<Reservation*, std::vector<Reservation*>, ReservationCompare>
-    > reservationQueues;
+    // Queue per ISBN, plus each user's reservations (oldest first). Both
+    // hold the same pointers; the queues own them.
+    std::unordered_map<ISBN, ReservationQueue> reservationQueues;
+    std::unordered_map<std::string, std::vector<Reservation*>> userReservations;
+
+    void queueReservation(Reservation* r);
+    void dropReservation(Reservation* r);
+    Reservation* findReservation(const std::string& userID, const ISBN& isbn) const;
+
+    // Hold shelf. A copy returned while its book has reservations is held
+    // for the head of the queue for HOLD_SECONDS; the timing wheel expires
+    // it and the copy passes to the next reservation, or back to the shelf.
+    static const long long HOLD_SECONDS = 3 * 24 * 60 * 60;
+    std::unordered_map<ISBN, std::vector<Hold*>> holdsByBook;
+    std::unordered_map<uint64_t, Hold*> holdsByTimer;
+    TimingWheel holdTimers;
+    uint64_t holdSerial;
+
+    Hold* placeHold(Book* book, const std::string& holdID, int copy, long long when);
+    void addHold(Hold* h);
+    void releaseHold(Hold* h);
+    void expireHold(Hold* h);
+    void deleteHold(Hold* h);       // and its reservation
+    Hold* findHold(const std::string& userID, const ISBN& isbn) const;
+    bool isHeld(const Book* book, int copy) const;
+
+    // Copy a user's return hands back, and the lowest copy out on loan.
+    int loanedCopy(const std::string& userID, const Book* book) const;
+    int firstLoanedCopy(const Book* book) const;
 
     std::stack<Transaction*> transactionHistory;
 
+    // Per-user view of transactionHistory, so profiles and personalized
+    // recommendations cost O(that user's history) rather than a scan of
+    // everyone's. Kept in step by pushTransaction / popTransaction.
+    struct UserHistory {
+        std::vector<Transaction*> transactions;         // oldest first
+        std::map<ISBN, long long> activeLoans;          // ISBN -> time the loan was issued
+    };
+    std::unordered_map<std::string, UserHistory> userHistories;
+
+    void pushTransaction(Transaction* t);
+    Transaction* popTransaction();
+    void deleteTransaction(Transaction* t);
+    void refreshLoan(const std::string& userID, UserHistory& history, const ISBN& isbn);
+
+    // Every active loan by due date, mirroring the activeLoans maps, so
+    // overdue and due-soon lists are range scans. setLoan / clearLoan keep
+    // the two in step.
+    static const long long LOAN_SECONDS = 14 * 24 * 60 * 60;
+    struct DueEntry {
+        long long dueDate;
+        std::string userID;
+        ISBN isbn;
+
+        bool operator<(const DueEntry& o) const {
+            if (dueDate != o.dueDate) return dueDate < o.dueDate;
+            if (userID != o.userID) return userID < o.userID;
+            return isbn < o.isbn;
+        }
+    };
+    std::set<DueEntry> dueIndex;
+
+    void setLoan(const std::string& userID, UserHistory& history,
+                 const ISBN& isbn, long long issued);
+    void clearLoan(const std::string& userID, UserHistory& history, const ISBN& isbn);
+
     int transactionCounter;
     int reservationCounter;
 
+    // Write-ahead journal for circulation; null until openJournal. Every
+    // operation is journaled before it touches memory.
+    Journal* journal;
+    uint64_t journalSequence;   // last journaled operation reflected in memory
+    long long replayTime;       // timestamp of the record being replayed, 0 when live
+    std::string journalPath;
+
+    // Fingerprint of the books.csv the catalog matches; 0 if unknown.
+    uint64_t catalogSource;
+
+    // Checkpoints: a snapshot of the full state written by a fork()ed child
+    // (pid 0 when none is running). Journal segments below
+    // checkpointSegment are dropped once it succeeds, and only then does
+    // checkpointSequence advance to the running one's pendingSequence.
+    long checkpointPid;
+    uint64_t checkpointSegment;
+    uint64_t checkpointSequence;    // journal sequence of the latest good checkpoint
+    uint64_t pendingSequence;
+
+    long long now() const;
+    void logOperation(JournalOp op, const std::string& userID,
+                      const std::string& isbn, long long when);
+
+    static std::vector<std::string> tokenize(const std::string& text);
+    std::vector<uint32_t> matchField(
+        AdaptiveTrie& trie, const std::vector<std::string>& tokens, int maxEdits
+    );
+    std::vector<ScoredDoc> scoreByImpact(const std::vector<uint32_t>& ids);
+    CachedPage computePage(const SearchQuery& query);
+
+    void indexBook(Book* book);
+    void unindexBook(Book* book);
+
 public:
     LibraryEngine();
     ~LibraryEngine();
 
-    // Books
+    // Books (takes ownership; a duplicate ISBN is discarded)
     void addBook(Book* book);
+    void addBooks(const std::vector<Book*>& batch);
+    Book* getBook(const ISBN& isbn);
+
+    // Parses isbn first; null if it is not an ISBN.
     Book* getBook(const std::string& isbn);
 
+    // Index getBook answers from (ISBN_INDEX by default). Selecting
+    // PERFECT_HASH builds it over the current catalog; catalog edits then
+    // keep it in step.
+    void setBookLookup(BookLookup lookup);
+
+    // Runtime catalog maintenance; every index is updated incrementally
+    json addCatalogBook(const std::string& isbn, const std::string& title,
+                        const std::string& author, const std::string& category,
+                        int copies);
+    json updateCatalogBook(const std::string& isbn, const json& changes);
+    json removeCatalogBook(const std::string& isbn);
+
+    // Live books in load order
+    std::vector<Book*> getCatalog();
+
     // Users
     void addUser(User* user);
     User* getUser(const std::string& userID);
 
-    // Search
-    std::vector<SearchResult> searchByTitle(const std::string& query);
-    std::vector<SearchResult> searchByAuthor(const std::string& query);
+    // Search, dispatched to the backend named in the query.
+    // Throws std::invalid_argument for a malformed cursor.
+    SearchPage search(const SearchQuery& query);
+
+    // Trie search (maxEdits > 0 enables typo-tolerant matching, up to 2 edits)
+    std::vector<SearchResult> searchByTitle(
+        const std::string& query, size_t limit = 0, int maxEdits = 0);
+    std::vector<SearchResult> searchByAuthor(
+        const std::string& query, size_t limit = 0, int maxEdits = 0);
+
+    json getCacheStats();
 
     // Circulation
     json issueBook(const std::string& userID, const std::string& isbn);
     json returnBook(const std::string& userID, const std::string& isbn);
     json reserveBook(const std::string& userID, const std::string& isbn);
 
+    // The user's latest reservation for isbn: cancel it, or report where it
+    // stands in the queue.
+    json cancelReservation(const std::string& userID, const std::string& isbn);
+    json reservationPosition(const std::string& userID, const std::string& isbn);
+
+    // Active loans due in [from, until], earliest first, at most limit (0 =
+    // all) per page; cursor is the previous page's nextCursor. Throws
+    // std::invalid_argument for a malformed cursor.
+    json loansDue(long long from, long long until, size_t limit, const std::string& cursor);
+
+    // Books whose ISBN starts with prefix (a registration group or
+    // publisher block, see ISBN::prefixRange), in ISBN order, at most
+    // limit (0 = all) per page; cursor is the previous page's nextCursor.
+    // A prefix shorter than the 978/979 EAN prefix ("", "9", "97")
+    // matches the whole catalog. Throws std::invalid_argument for a
+    // malformed cursor.
+    json browseISBN(const std::string& prefix, size_t limit, const std::string& cursor);
+
+    // Expires the holds whose time is up, passing each copy on. Call from
+    // the request loop; returns the number expired.
+    size_t expireHolds();
+
     // Recommendations
     std::vector<SearchResult> getRecommendations(const std::string& isbn, int limit);
     std::vector<SearchResult> getPersonalizedRecommendations(
@@ -77,9 +261,50 @@ public:
     // Profile
     json getUserProfile(const std::string& userID);
 
-    // Setup
-    void buildSearchIndices();
+    // Setup. The indexes are built side by side on up to `threads`
+    // threads (0 = one per core, 1 = serial).
+    void buildSearchIndices(unsigned threads = 0);
     void buildRecommendationGraph();
+
+    // Binary snapshot of the catalog, ISBN index, tries, suffix array,
+    // recommendation graph, users and circulation state. Loading replaces
+    // the CSV load and both build steps; it expects an empty engine and
+    // throws std::runtime_error if the file is unusable, leaving the engine
+    // to be discarded. With withCatalog = false only users and circulation
+    // state are restored, onto books already loaded from CSV (matched by
+    // ISBN) and before the indexes are built; a book whose CSV copy count
+    // is below its copies out keeps just those. Reservations and
+    // holds for books not in the catalog are dropped. Returns a message for
+    // each such mismatch, for the caller to log.
+    json saveSnapshot(const std::string& path);
+    std::vector<std::string> loadSnapshot(const std::string& path, bool withCatalog = true);
+
+    // Fingerprint of books.csv as it now stands, to be set at startup and
+    // after every write to it. Snapshots record it, and loading a
+    // snapshot's catalog throws if it differs, since books.csv then has
+    // edits the snapshot missed (a checkpoint's child can outlive them).
+    // 0 means unknown and skips the check.
+    void setCatalogSource(uint64_t fingerprint);
+
+    // Snapshot at the current journal position, after which the journal
+    // segments it covers are deleted. In the background the snapshot is
+    // written by a fork()ed copy-on-write child and finished by
+    // pollCheckpoint; where fork() is unavailable it is written inline.
+    json checkpoint(const std::string& path, bool background);
+
+    enum class CheckpointStatus { IDLE, RUNNING, SUCCEEDED, FAILED };
+
+    // Reaps a finished background checkpoint; with wait, blocks until the
+    // running one ends. Call from the request loop.
+    CheckpointStatus pollCheckpoint(bool wait = false);
+
+    uint64_t journalRecordsSinceCheckpoint() const;
+
+    // Replays the journal's records newer than the loaded state (with their
+    // original timestamps), then keeps appending to it. Call once, after
+    // the catalog, users and indexes are loaded. Returns the number of
+    // records replayed; throws std::runtime_error if the journal is unusable.
+    size_t openJournal(const std::string& path, const JournalOptions& options);
 };
 
 #endif
@@ -1,62 +1,38 @@
 #include "library_engine.h"
+#include "csv_loader.h"
+#include "atomic_file.h"
+#include "crc32.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <ctime>
+#include <thread>
+#include <filesystem>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
 LibraryEngine* engine = nullptr;
 
+const std::string BOOKS_CSV = "data/books.csv";
+const std::string SNAPSHOT_PATH = "data/library.snapshot";
+const std::string JOURNAL_PATH = "data/circulation.journal";
+
 /* ---------------- CSV PARSING ---------------- */
 
 std::vector<std::string> parseCSVLine(const std::string& line) {
     std::vector<std::string> fields;
-    std::string current;
-    bool inQuotes = false;
-
-    for (char c : line) {
-        if (c == '"') {
-            inQuotes = !inQuotes;
-        } else if (c == ',' && !inQuotes) {
-            fields.push_back(current);
-            current.clear();
-        } else {
-            current += c;
-        }
-    }
-    fields.push_back(current);
+    splitCSVRecord(line.data(), line.data() + line.size(), fields);
     return fields;
 }
 
 void loadBooksFromCSV(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) return;
-
-    std::string line;
-    bool header = true;
-
-    while (std::getline(file, line)) {
-        if (header) {
-            header = false;
-            continue;
-        }
-
-        auto fields = parseCSVLine(line);
-        if (fields.size() < 5) continue;
-
-        std::string isbn = fields[0];
-        std::string title = fields[1];
-        std::string author = fields[2];
-        std::string category = fields[3];
-
-        int copies = 1;
-        try { copies = std::stoi(fields[4]); }
-        catch (...) {}
-
-        Book* book = new Book(isbn, title, author, category, copies);
-        engine->addBook(book);
-    }
+    engine->addBooks(readBooksCSV(path));
 }
 
 void loadUsersFromCSV(const std::string& path) {
@@ -99,25 +75,186 @@ void saveUserToCSV(const std::string& path, const std::string& uid, const std::s
     file << uid << "," << name << "," << uid + "@library.edu" << "," << typeStr << "\n";
 }
 
+static std::string csvField(const std::string& value) {
+    if (value.find_first_of(",\"\n") == std::string::npos) return value;
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void writeBookRow(std::ostream& out, const Book* b) {
+    out << csvField(b->isbn.str()) << "," << csvField(b->title) << ","
+        << csvField(b->author) << "," << csvField(b->category) << ","
+        << b->totalCopies << "\n";
+}
+
+void saveBookToCSV(const std::string& path, const Book* book) {
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open()) return;
+    writeBookRow(file, book);
+}
+
+// Updates and removals rewrite the catalog. The new file replaces the old
+// atomically, so a crash leaves one or the other, never a truncated or
+// missing books.csv. False if it could not be written.
+bool rewriteBooksCSV(const std::string& path) {
+    std::ostringstream file;
+    file << "ISBN,Title,Author,Category,Copies\n";
+    for (const Book* b : engine->getCatalog())
+        writeBookRow(file, b);
+
+    std::string data = file.str();
+    return writeFileAtomically(path, data.data(), data.size());
+}
+
+// The engine has the edit but books.csv does not.
+json catalogNotSaved() {
+    return { {"success", false}, {"message", "Catalog changed in memory but books.csv could not be written"} };
+}
+
+/* ---------------- SNAPSHOT ---------------- */
+
+// The file's size and CRC32 (size in the high half), or 0 if it cannot be
+// read.
+uint64_t catalogFingerprint(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return 0;
+
+    char chunk[1 << 16];
+    uint64_t size = 0;
+    uint32_t crc = 0;
+    while (file.read(chunk, sizeof chunk) || file.gcount() > 0) {
+        crc = crc32(chunk, file.gcount(), crc);
+        size += file.gcount();
+    }
+    return (size << 32) | crc;
+}
+
+// At startup and after every write to books.csv, so checkpoints record
+// which catalog they hold.
+void noteCatalogSource() {
+    engine->setCatalogSource(catalogFingerprint(BOOKS_CSV));
+}
+
+// Uses the snapshot unless it is missing, taken from a different books.csv
+// (a catalog edit it does not have) or unreadable; in the last two cases
+// the partly loaded engine is replaced so the CSV path starts clean.
+bool loadCatalogSnapshot() {
+    std::error_code ec;
+    if (!std::filesystem::exists(SNAPSHOT_PATH, ec)) return false;
+
+    try {
+        noteCatalogSource();
+        for (const auto& w : engine->loadSnapshot(SNAPSHOT_PATH))
+            std::cerr << "Snapshot: " << w << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring snapshot: " << e.what() << std::endl;
+        delete engine;
+        engine = new LibraryEngine();
+        return false;
+    }
+}
+
+// When the catalog came from books.csv, a snapshot still holds the users and
+// circulation state its checkpoint took out of the journal. Applied onto the
+// CSV books before the indexes are built; if that fails the engine is
+// reloaded from CSV alone.
+void restoreCirculationSnapshot() {
+    std::error_code ec;
+    if (!std::filesystem::exists(SNAPSHOT_PATH, ec)) return;
+
+    try {
+        for (const auto& w : engine->loadSnapshot(SNAPSHOT_PATH, false))
+            std::cerr << "Snapshot: " << w << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring snapshot circulation state: " << e.what() << std::endl;
+        delete engine;
+        engine = new LibraryEngine();
+        loadBooksFromCSV(BOOKS_CSV);
+    }
+}
+
+/* ---------------- BENCHMARK ---------------- */
+
+// library.exe --bench-index-build [books.csv]
+// Times buildSearchIndices at 1, 2, 4 ... threads up to the core count,
+// best of three runs on a freshly loaded catalog each time.
+int benchIndexBuild(const std::string& path) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < cores; t *= 2) counts.push_back(t);
+    counts.push_back(cores);
+
+    size_t bookCount = 0;
+    std::vector<std::pair<unsigned, double>> rows;
+
+    for (unsigned threads : counts) {
+        double best = 0;
+        for (int run = 0; run < 3; run++) {
+            LibraryEngine bench;
+            bench.addBooks(readBooksCSV(path));
+            bookCount = bench.getCatalog().size();
+
+            auto start = std::chrono::steady_clock::now();
+            bench.buildSearchIndices(threads);
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            if (run == 0 || took.count() < best) best = took.count();
+        }
+        rows.push_back(std::make_pair(threads, best));
+    }
+
+    std::printf("Index build: %zu books, %u cores\n", bookCount, cores);
+    std::printf("%-8s %10s %8s\n", "threads", "ms", "speedup");
+    for (const auto& r : rows)
+        std::printf("%-8u %10.1f %7.2fx\n", r.first, r.second, rows[0].second / r.second);
+    return 0;
+}
+
 /* ---------------- HANDLERS ---------------- */
 
 json handleSearch(const json& req) {
     json res;
     std::string query = req.value("query", "");
     std::string type = req.value("type", "title");
+    int limit = req.value("limit", 0);
+    if (limit < 0) limit = 0;
+
+    // "fuzzy": true or a max edit distance (1 or 2)
+    int fuzzy = 0;
+    auto f = req.find("fuzzy");
+    if (f != req.end()) {
+        if (f->is_boolean()) fuzzy = f->get<bool>() ? 2 : 0;
+        else if (f->is_number()) fuzzy = std::max(0, std::min(2, f->get<int>()));
+    }
 
-    std::vector<SearchResult> results =
-        (type == "author")
-        ? engine->searchByAuthor(query)
-        : engine->searchByTitle(query);
+    SearchQuery q;
+    q.text = query;
+    q.fields = (type == "author") ? FIELD_AUTHOR
+             : (type == "all") ? FIELD_ALL
+             : FIELD_TITLE;
+    std::string backend = req.value("engine", "trie");
+    q.backend = (backend == "bm25") ? SearchBackend::BM25
+              : (backend == "substring") ? SearchBackend::SUBSTRING
+              : SearchBackend::TRIE;
+    q.limit = limit;
+    q.cursor = req.value("cursor", "");
+    q.maxEdits = fuzzy;
+
+    SearchPage page = engine->search(q);
 
     res["success"] = true;
-    res["count"] = results.size();
+    res["count"] = page.results.size();
     res["results"] = json::array();
+    if (!page.nextCursor.empty())
+        res["nextCursor"] = page.nextCursor;
 
-    for (const auto& r : results) {
+    for (const auto& r : page.results) {
         res["results"].push_back({
-            {"isbn", r.isbn},
+            {"isbn", r.isbn.str()},
             {"title", r.title},
             {"author", r.author},
             {"category", r.category},
@@ -163,7 +300,7 @@ json handleRecommend(const json& req) {
 
     for (const auto& r : results) {
         res["results"].push_back({
-            {"isbn", r.isbn},
+            {"isbn", r.isbn.str()},
             {"title", r.title},
             {"author", r.author},
             {"category", r.category},
@@ -193,7 +330,7 @@ json handlePersonalizedRecommend(const json& req) {
 
     for (const auto& r : results) {
         res["results"].push_back({
-            {"isbn", r.isbn},
+            {"isbn", r.isbn.str()},
             {"title", r.title},
             {"author", r.author},
             {"category", r.category},
@@ -205,22 +342,119 @@ json handlePersonalizedRecommend(const json& req) {
     return res;
 }
 
+json handleAddBook(const json& req) {
+    std::string isbn = req.value("isbn", "");
+    json res = engine->addCatalogBook(
+        isbn,
+        req.value("title", ""),
+        req.value("author", ""),
+        req.value("category", ""),
+        req.value("copies", 1)
+    );
+    if (res["success"]) {
+        saveBookToCSV(BOOKS_CSV, engine->getBook(isbn));
+        noteCatalogSource();
+    }
+    return res;
+}
+
+json handleUpdateBook(const json& req) {
+    json res = engine->updateCatalogBook(req.value("isbn", ""), req);
+    if (!res["success"]) return res;
+    if (!rewriteBooksCSV(BOOKS_CSV)) return catalogNotSaved();
+    noteCatalogSource();
+    return res;
+}
+
+json handleRemoveBook(const json& req) {
+    json res = engine->removeCatalogBook(req.value("isbn", ""));
+    if (!res["success"]) return res;
+    if (!rewriteBooksCSV(BOOKS_CSV)) return catalogNotSaved();
+    noteCatalogSource();
+    return res;
+}
+
+// Overdue: due before now. due_within: due in the next `days` days (default 3).
+json handleOverdueReport(const json& req) {
+    long long now = time(nullptr);
+    size_t limit = std::max(0, req.value("limit", 100));
+    return engine->loansDue(LLONG_MIN, now - 1, limit, req.value("cursor", ""));
+}
+
+json handleDueWithin(const json& req) {
+    long long now = time(nullptr);
+    long long days = std::max(0, req.value("days", 3));
+    size_t limit = std::max(0, req.value("limit", 100));
+    return engine->loansDue(now, now + days * 24 * 60 * 60, limit, req.value("cursor", ""));
+}
+
+// Books under an ISBN prefix (registration group or publisher block).
+json handleBrowseISBN(const json& req) {
+    size_t limit = std::max(0, req.value("limit", 100));
+    return engine->browseISBN(req.value("prefix", ""), limit, req.value("cursor", ""));
+}
+
 /* ---------------- MAIN ---------------- */
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench-index-build")
+        return benchIndexBuild(argc > 2 ? argv[2] : BOOKS_CSV);
+
+    // Group commit: fsync the journal every N ms or every N records.
+    // Checkpoint in the background every N journal records, or every N
+    // seconds when anything was journaled since the last one.
+    JournalOptions journalOptions;
+    unsigned checkpointRecords = 5000;
+    unsigned checkpointIntervalS = 300;
+    bool perfectHash = false;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        unsigned value = std::strtoul(argv[i + 1], nullptr, 10);
+        if (flag == "--commit-interval-ms") journalOptions.commitIntervalMs = value;
+        else if (flag == "--commit-records") journalOptions.commitRecords = std::max(1u, value);
+        else if (flag == "--checkpoint-records") checkpointRecords = std::max(1u, value);
+        else if (flag == "--checkpoint-interval-s") checkpointIntervalS = value;
+        else if (flag == "--book-lookup") perfectHash = std::string(argv[i + 1]) == "perfect_hash";
+    }
+
     engine = new LibraryEngine();
 
-    loadBooksFromCSV("data/books.csv");
+    bool fromSnapshot = loadCatalogSnapshot();
+    if (!fromSnapshot) {
+        loadBooksFromCSV(BOOKS_CSV);
+        restoreCirculationSnapshot();
+    }
     loadUsersFromCSV("data/users.csv");
-    engine->buildSearchIndices();
-    engine->buildRecommendationGraph();
+    if (!fromSnapshot) {
+        engine->buildSearchIndices();
+        engine->buildRecommendationGraph();
+    }
+    if (perfectHash) engine->setBookLookup(BookLookup::PERFECT_HASH);
+    noteCatalogSource();
+
+    try {
+        size_t replayed = engine->openJournal(JOURNAL_PATH, journalOptions);
+        if (replayed > 0)
+            std::cerr << "Replayed " << replayed << " journal records" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Journal disabled: " << e.what() << std::endl;
+    }
 
     std::cout << "Library System Ready" << std::endl;
     std::cout.flush();
 
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+
     std::string input;
     while (std::getline(std::cin, input)) {
         if (input.empty()) continue;
+
+        // Holds that ran out while we waited for input pass on first.
+        try {
+            engine->expireHolds();
+        } catch (const std::exception& e) {
+            std::cerr << "Hold expiry failed: " << e.what() << std::endl;
+        }
         
         try {
             json request = json::parse(input);
@@ -232,9 +466,22 @@ int main() {
             else if (action == "issue") response = handleIssue(request);
             else if (action == "return") response = handleReturn(request);
             else if (action == "reserve") response = handleReserve(request);
+            else if (action == "cancel_reservation")
+                response = engine->cancelReservation(request.value("userID", ""), request.value("isbn", ""));
+            else if (action == "reservation_position")
+                response = engine->reservationPosition(request.value("userID", ""), request.value("isbn", ""));
             else if (action == "recommendations") response = handleRecommend(request);
             else if (action == "personalized_recommendations") response = handlePersonalizedRecommend(request);
             else if (action == "undo") response = engine->undoLastAction();
+            else if (action == "cache_stats") response = engine->getCacheStats();
+            else if (action == "snapshot") response = engine->checkpoint(SNAPSHOT_PATH, false);
+            else if (action == "checkpoint") response = engine->checkpoint(SNAPSHOT_PATH, true);
+            else if (action == "add_book") response = handleAddBook(request);
+            else if (action == "update_book") response = handleUpdateBook(request);
+            else if (action == "remove_book") response = handleRemoveBook(request);
+            else if (action == "overdue_report") response = handleOverdueReport(request);
+            else if (action == "due_within") response = handleDueWithin(request);
+            else if (action == "browse_isbn") response = handleBrowseISBN(request);
             else if (action == "profile") response = engine->getUserProfile(request.value("userID", ""));
             else if (action == "add_user") {
                 std::string uid = request.value("userID", "");
@@ -265,8 +512,24 @@ int main() {
             std::cout << error.dump() << std::endl;
             std::cout.flush();
         }
+
+        if (engine->pollCheckpoint() == LibraryEngine::CheckpointStatus::FAILED)
+            std::cerr << "Background checkpoint failed" << std::endl;
+
+        uint64_t pending = engine->journalRecordsSinceCheckpoint();
+        auto elapsed = std::chrono::steady_clock::now() - lastCheckpoint;
+        if (pending >= checkpointRecords ||
+            (pending > 0 && elapsed >= std::chrono::seconds(checkpointIntervalS))) {
+            try {
+                if (engine->checkpoint(SNAPSHOT_PATH, true)["success"])
+                    lastCheckpoint = std::chrono::steady_clock::now();
+            } catch (const std::exception& e) {
+                std::cerr << "Checkpoint failed: " << e.what() << std::endl;
+            }
+        }
     }
 
+    engine->pollCheckpoint(true);
     delete engine;
     return 0;
 }
@@ -1,81 +1,146 @@
 #ifndef MODELS_H
 #define MODELS_H
 
+#include "isbn.h"
 #include <string>
+#include <vector>
 #include <ctime>
+#include <cstdint>
 
 /* ================= ENUMS ================= */
 
 enum class UserType { STUDENT, FINAL_YEAR_STUDENT, FACULTY };
 enum class TransactionType { ISSUE, RETURN };
 
-/* ================= COPY (LINKED LIST NODE) ================= */
-
-struct Copy {
-    std::string copyID;
-    bool isAvailable;
-    std::string issuedTo;
-    long long issuedDate;
-    Copy* next;
-
-    Copy(const std::string& id)
-        : copyID(id), isAvailable(true),
-          issuedDate(0), next(nullptr) {}
-};
-
 /* ================= BOOK ================= */
 
+// Copies are numbered 0, 1, 2 ... per book and a number is never reused,
+// so a copy ID always names the same physical copy. Copy state lives in
+// two bitmaps: on the shelf, and withdrawn from the catalog. A copy in
+// neither is out (on loan or on the hold shelf).
 struct Book {
-    std::string isbn;
+    ISBN isbn;
     std::string title;
     std::string author;
     std::string category;
 
     int totalCopies;
-    int availableCopies;
+    int availableCopies;        // copies on the shelf
 
-    Copy* copiesHead;
+    uint32_t copySlots;         // copy numbers handed out so far
+    std::vector<uint64_t> copyShelf;
+    std::vector<uint64_t> copyWithdrawn;
 
-    long long searchFrequency;
     long long borrowImpact;
 
+    // Dense index assigned by LibraryEngine::addBook; used by the search indexes.
+    uint32_t docID;
+
     Book()
-        : totalCopies(0), availableCopies(0),
-          copiesHead(nullptr),
-          searchFrequency(0), borrowImpact(0) {}
+        : totalCopies(0), availableCopies(0), copySlots(0),
+          borrowImpact(0), docID(0) {}
 
-    Book(const std::string& i, const std::string& t,
+    Book(const ISBN& i, const std::string& t,
          const std::string& a, const std::string& c, int total)
         : isbn(i), title(t), author(a), category(c),
-          totalCopies(total), availableCopies(total),
-          copiesHead(nullptr),
-          searchFrequency(0), borrowImpact(0) {
-
-        // Create linked list of copies
-        for (int k = 0; k < totalCopies; k++) {
-            Copy* newCopy = new Copy(isbn + "_COPY_" + std::to_string(k));
-            newCopy->next = copiesHead;
-            copiesHead = newCopy;
+          totalCopies(0), availableCopies(0), copySlots(0),
+          borrowImpact(0), docID(0) {
+        setTotalCopies(total);
+    }
+
+    // IDs are built on demand rather than stored per copy.
+    std::string copyID(int k) const { return isbn.str() + "_COPY_" + std::to_string(k); }
+
+    // Copy number of one of this book's copy IDs, or -1.
+    int copyNumber(const std::string& id) const {
+        std::string prefix = isbn.str() + "_COPY_";
+        if (id.size() <= prefix.size() || id.compare(0, prefix.size(), prefix) != 0 ||
+            id.find_first_not_of("0123456789", prefix.size()) != std::string::npos)
+            return -1;
+        unsigned long k = std::stoul(id.substr(prefix.size()));
+        return k < copySlots ? static_cast<int>(k) : -1;
+    }
+
+    bool isOnShelf(int k) const {
+        return k >= 0 && static_cast<uint32_t>(k) < copySlots && (copyShelf[k >> 6] >> (k & 63)) & 1;
+    }
+
+    // Still in the catalog and not on the shelf.
+    bool isOut(int k) const {
+        return k >= 0 && static_cast<uint32_t>(k) < copySlots &&
+               !((copyShelf[k >> 6] | copyWithdrawn[k >> 6]) >> (k & 63) & 1);
+    }
+
+    // Takes the lowest-numbered copy off the shelf; -1 if none is there.
+    int takeCopy() {
+        for (size_t w = 0; w < copyShelf.size(); w++) {
+            if (copyShelf[w]) {
+                int k = static_cast<int>(w * 64 + __builtin_ctzll(copyShelf[w]));
+                takeCopy(k);
+                return k;
+            }
         }
+        return -1;
+    }
+
+    bool takeCopy(int k) {
+        if (!isOnShelf(k)) return false;
+        copyShelf[k >> 6] &= ~(1ULL << (k & 63));
+        availableCopies--;
+        return true;
     }
 
-    // Get first available copy
-    Copy* getAvailableCopy() {
-        Copy* curr = copiesHead;
-        while (curr) {
-            if (curr->isAvailable)
-                return curr;
-            curr = curr->next;
+    void shelveCopy(int k) {
+        if (!isOut(k)) return;
+        copyShelf[k >> 6] |= 1ULL << (k & 63);
+        availableCopies++;
+    }
+
+    // Adds new copies, or withdraws shelved ones (highest number first);
+    // copies that are out cannot be withdrawn.
+    bool setTotalCopies(int total) {
+        if (total < totalCopies - availableCopies) return false;
+
+        while (totalCopies < total) {
+            uint32_t k = copySlots++;
+            if ((k & 63) == 0) {
+                copyShelf.push_back(0);
+                copyWithdrawn.push_back(0);
+            }
+            copyShelf[k >> 6] |= 1ULL << (k & 63);
+            totalCopies++;
+            availableCopies++;
         }
-        return nullptr;
+
+        for (int k = static_cast<int>(copySlots) - 1; totalCopies > total && k >= 0; k--) {
+            if (!takeCopy(k)) continue;
+            copyWithdrawn[k >> 6] |= 1ULL << (k & 63);
+            totalCopies--;
+        }
+        return true;
     }
 
-    ~Book() {
-        Copy* curr = copiesHead;
-        while (curr) {
-            Copy* temp = curr;
-            curr = curr->next;
-            delete temp;
+    // Replaces the copy state wholesale (snapshot restore). Each array holds
+    // (slots + 63) / 64 words.
+    void restoreCopies(uint32_t slots, const uint64_t* shelf, const uint64_t* withdrawn) {
+        size_t words = (slots + 63) / 64;
+        copySlots = slots;
+        copyShelf.assign(shelf, shelf + words);
+        copyWithdrawn.assign(withdrawn, withdrawn + words);
+
+        // Bits past the last copy, or both on the shelf and withdrawn, are
+        // not trusted.
+        if (slots & 63) {
+            uint64_t valid = (1ULL << (slots & 63)) - 1;
+            copyShelf.back() &= valid;
+            copyWithdrawn.back() &= valid;
+        }
+        totalCopies = static_cast<int>(slots);
+        availableCopies = 0;
+        for (size_t w = 0; w < words; w++) {
+            copyShelf[w] &= ~copyWithdrawn[w];
+            availableCopies += __builtin_popcountll(copyShelf[w]);
+            totalCopies -= __builtin_popcountll(copyWithdrawn[w]);
         }
     }
 };
@@ -99,20 +164,23 @@ struct User {
 
 /* ================= TRANSACTION ================= */
 
+struct Hold;
+
 struct Transaction {
     std::string transactionID;
     std::string userID;
-    std::string bookID;
+    ISBN bookID;
     std::string copyID;
     TransactionType type;
     long long timestamp;
+    Hold* pickedUp;             // the hold an issue took off the shelf, owned; null otherwise
 
     Transaction(const std::string& tid, const std::string& uid,
-                const std::string& bid, const std::string& cid,
+                const ISBN& bid, const std::string& cid,
                 TransactionType t)
         : transactionID(tid), userID(uid),
           bookID(bid), copyID(cid),
-          type(t), timestamp(time(nullptr)) {}
+          type(t), timestamp(time(nullptr)), pickedUp(nullptr) {}
 };
 
 /* ================= RESERVATION ================= */
@@ -120,12 +188,12 @@ struct Transaction {
 struct Reservation {
     std::string reservationID;
     std::string userID;
-    std::string bookID;
+    ISBN bookID;
     long long timestamp;
     int priorityScore;
 
     Reservation(const std::string& rid, const std::string& uid,
-                const std::string& bid, UserType type)
+                const ISBN& bid, UserType type)
         : reservationID(rid), userID(uid),
           bookID(bid), timestamp(time(nullptr)) {
 
@@ -138,11 +206,22 @@ struct Reservation {
     }
 };
 
+/* ================= HOLD ================= */
+
+// A returned copy kept on the hold shelf for the reservation that was at
+// the head of the queue.
+struct Hold {
+    std::string holdID;         // the return that freed the copy; kept when the hold passes on
+    Reservation* reservation;   // owned by the hold
+    int copy;                   // copy number set aside
+    long long expiresAt;
+    uint64_t timer;             // ID in the engine's timing wheel
+};
+
 /* ================= SEARCH RESULT ================= */
 
 struct SearchResult {
-    std::string bookID;
-    std::string isbn;
+    ISBN isbn;
     std::string title;
     std::string author;
     std::string category;
@@ -156,4 +235,46 @@ struct SearchResult {
           relevanceScore(0) {}
 };
 
+/* ================= RANKING HELPERS ================= */
+
+// A search hit before materialization. Every search path orders hits by
+// score (descending) and then docID (ascending), which is a total order and
+// what pagination cursors encode.
+struct ScoredDoc {
+    uint32_t docID;
+    double score;
+};
+
+inline bool rankedBefore(const ScoredDoc& a, const ScoredDoc& b) {
+    if (a.score != b.score) return a.score > b.score;
+    return a.docID < b.docID;
+}
+
+// The same order for popularity-ranked paths (score = borrowImpact).
+inline bool ranksHigher(const Book* a, const Book* b) {
+    if (a->borrowImpact != b->borrowImpact)
+        return a->borrowImpact > b->borrowImpact;
+    return a->docID < b->docID;
+}
+
+// Recommendation order: relevance (descending), then ISBN, so ties do not
+// depend on hash-map iteration order.
+inline bool recommendedBefore(const SearchResult& a, const SearchResult& b) {
+    if (a.relevanceScore != b.relevanceScore)
+        return a.relevanceScore > b.relevanceScore;
+    return a.isbn < b.isbn;
+}
+
+inline SearchResult toSearchResult(const Book* b) {
+    SearchResult r;
+    r.isbn = b->isbn;
+    r.title = b->title;
+    r.author = b->author;
+    r.category = b->category;
+    r.availableCopies = b->availableCopies;
+    r.totalCopies = b->totalCopies;
+    r.relevanceScore = b->borrowImpact;
+    return r;
+}
+
 #endif
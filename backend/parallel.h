@@ -0,0 +1,50 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Worker count for a request of `threads` (0 = one per core).
+inline unsigned resolveThreads(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    return std::max(1u, threads);
+}
+
+// Runs task(0 .. count - 1), task 0 on the calling thread. Every task runs
+// to completion; if any threw, the lowest-numbered one's exception is
+// rethrown here once all have finished.
+inline void runParallel(unsigned count, const std::function<void(unsigned)>& task) {
+    std::vector<std::exception_ptr> errors(std::max(1u, count));
+    auto run = [&](unsigned t) {
+        try {
+            task(t);
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < count; t++)
+        workers.emplace_back(run, t);
+    run(0);
+    for (auto& w : workers) w.join();
+
+    for (const auto& e : errors)
+        if (e) std::rethrow_exception(e);
+}
+
+// Runs every job, each on one of up to `threads` workers.
+inline void runConcurrently(const std::vector<std::function<void()>>& jobs, unsigned threads) {
+    std::atomic<size_t> next(0);
+    unsigned workers = std::min<size_t>(resolveThreads(threads), jobs.size());
+    runParallel(workers, [&](unsigned) {
+        for (size_t j; (j = next++) < jobs.size();)
+            jobs[j]();
+    });
+}
+
+#endif
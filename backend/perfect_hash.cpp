@@ -0,0 +1,265 @@
+#include "perfect_hash.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Buckets are BUCKET_FACTOR * n / log2(n): about four keys each at a
+// million books. Positions are n / LOAD, so the last buckets still find
+// free ones without a long pilot search.
+const double BUCKET_FACTOR = 5.0;
+const double LOAD = 0.99;
+const uint32_t MAX_PILOT = 0xffff;
+const unsigned MAX_SEEDS = 16;
+
+// Overflow entries plus removed slots that start a rebuild, at least.
+const size_t MIN_EDITS = 64;
+
+// MurmurHash3's 64-bit finalizer.
+uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// x scaled onto [0, n) without a division.
+uint64_t scale(uint64_t x, uint64_t n) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(x) * n) >> 64);
+}
+
+// 60% of the keys go to the first 30% of the buckets. Placing those big
+// buckets first, while the table is empty, is what keeps pilots small.
+uint64_t bucketOf(uint64_t h, uint64_t buckets) {
+    uint64_t dense = buckets * 3 / 10;
+    uint64_t spread = h * 0x9e3779b97f4a7c15ULL;
+    if (dense == 0) return scale(spread, buckets);
+    return h < 0x999999999999999aULL ? scale(spread, dense)
+                                     : dense + scale(spread, buckets - dense);
+}
+
+uint64_t positionOf(uint64_t h, uint64_t pilotHash, uint64_t positions) {
+    return scale(mix(h ^ pilotHash), positions);
+}
+
+}
+
+PerfectHashIndex::PerfectHashIndex()
+    : removed(0), nextReady(false), nextBuilt(false) {}
+
+PerfectHashIndex::~PerfectHashIndex() {
+    if (builder.joinable()) builder.join();
+}
+
+/* ================= CONSTRUCTION ================= */
+
+bool PerfectHashIndex::buildTable(const std::vector<std::pair<uint64_t, Book*>>& entries,
+                                  Table& out) {
+    size_t n = entries.size();
+    out = Table();
+    if (n == 0) return true;
+
+    double bits = std::max(1.0, std::log2(static_cast<double>(n)));
+    uint64_t buckets = std::max<uint64_t>(1, static_cast<uint64_t>(BUCKET_FACTOR * n / bits));
+    uint64_t positions = static_cast<uint64_t>(n / LOAD) + 1;
+
+    std::vector<uint64_t> hashes(n);
+    std::vector<uint32_t> start(buckets + 1);
+    std::vector<uint32_t> byBucket(n);
+    std::vector<uint32_t> order(buckets);
+    std::vector<uint64_t> taken((positions + 63) / 64);
+    std::vector<uint64_t> spots;
+
+    for (unsigned attempt = 0; attempt < MAX_SEEDS; attempt++) {
+        uint64_t seed = mix(attempt + 1);
+
+        // Keys grouped by bucket (counting sort), then buckets largest first.
+        std::fill(start.begin(), start.end(), 0);
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = mix(entries[i].first ^ seed);
+            start[bucketOf(hashes[i], buckets) + 1]++;
+        }
+        uint32_t largest = 0;
+        for (uint64_t b = 0; b < buckets; b++) {
+            largest = std::max(largest, start[b + 1]);
+            start[b + 1] += start[b];
+        }
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < n; i++)
+            byBucket[fill[bucketOf(hashes[i], buckets)]++] = static_cast<uint32_t>(i);
+
+        std::vector<uint32_t> bySize(largest + 2);
+        for (uint64_t b = 0; b < buckets; b++)
+            bySize[largest - (start[b + 1] - start[b]) + 1]++;
+        for (uint32_t s = 0; s <= largest; s++) bySize[s + 1] += bySize[s];
+        for (uint64_t b = 0; b < buckets; b++)
+            order[bySize[largest - (start[b + 1] - start[b])]++] = static_cast<uint32_t>(b);
+
+        std::fill(taken.begin(), taken.end(), 0);
+        out.pilots.assign(buckets, 0);
+        bool placed = true;
+
+        for (uint32_t b : order) {
+            if (start[b + 1] == start[b]) break;
+
+            bool found = false;
+            for (uint32_t pilot = 0; pilot <= MAX_PILOT && !found; pilot++) {
+                uint64_t pilotHash = mix(pilot ^ seed);
+                spots.clear();
+                for (uint32_t j = start[b]; j < start[b + 1]; j++) {
+                    uint64_t p = positionOf(hashes[byBucket[j]], pilotHash, positions);
+                    if ((taken[p / 64] >> (p % 64)) & 1 ||
+                        std::find(spots.begin(), spots.end(), p) != spots.end())
+                        break;
+                    spots.push_back(p);
+                }
+                if (spots.size() != start[b + 1] - start[b]) continue;
+
+                for (uint64_t p : spots) taken[p / 64] |= 1ULL << (p % 64);
+                out.pilots[b] = static_cast<uint16_t>(pilot);
+                found = true;
+            }
+            if (!found) {
+                placed = false;
+                break;
+            }
+        }
+        if (!placed) continue;
+
+        // Positions past n take the gaps below it, in order.
+        out.remap.assign(positions - n, 0);
+        uint64_t gap = 0;
+        for (uint64_t p = n; p < positions; p++) {
+            if (!((taken[p / 64] >> (p % 64)) & 1)) continue;
+            while ((taken[gap / 64] >> (gap % 64)) & 1) gap++;
+            out.remap[p - n] = static_cast<uint32_t>(gap++);
+        }
+
+        out.seed = seed;
+        out.buckets = buckets;
+        out.positions = positions;
+        out.slots.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t h = hashes[i];
+            uint64_t p = positionOf(h, mix(out.pilots[bucketOf(h, buckets)] ^ seed), positions);
+            if (p >= n) p = out.remap[p - n];
+            out.slots[p].key = entries[i].first;
+            out.slots[p].book = entries[i].second;
+        }
+        return true;
+    }
+
+    out = Table();
+    return false;
+}
+
+void PerfectHashIndex::build(const std::vector<Book*>& books) {
+    if (builder.joinable()) {
+        builder.join();
+        nextReady = false;
+        next = Table();
+        editsSinceCopy.clear();
+    }
+
+    std::vector<std::pair<uint64_t, Book*>> entries;
+    entries.reserve(books.size());
+    for (Book* b : books) entries.emplace_back(b->isbn.id(), b);
+
+    Table built;
+    if (!buildTable(entries, built))
+        throw std::runtime_error("Perfect hash build failed");
+    table = std::move(built);
+    overflow.clear();
+    removed = 0;
+}
+
+/* ================= LOOKUP ================= */
+
+PerfectHashIndex::Slot* PerfectHashIndex::find(uint64_t key) {
+    size_t n = table.slots.size();
+    if (n == 0) return nullptr;
+
+    uint64_t h = mix(key ^ table.seed);
+    uint16_t pilot = table.pilots[bucketOf(h, table.buckets)];
+    uint64_t p = positionOf(h, mix(pilot ^ table.seed), table.positions);
+    if (p >= n) p = table.remap[p - n];
+
+    Slot& slot = table.slots[p];
+    return slot.key == key ? &slot : nullptr;
+}
+
+Book* PerfectHashIndex::search(const ISBN& key) {
+    if (nextReady.load(std::memory_order_acquire)) adopt();
+
+    Slot* slot = find(key.id());
+    if (slot) return slot->book;
+    if (overflow.empty()) return nullptr;
+
+    auto it = overflow.find(key.id());
+    return it == overflow.end() ? nullptr : it->second;
+}
+
+/* ================= UPDATES ================= */
+
+void PerfectHashIndex::put(uint64_t key, Book* book) {
+    Slot* slot = find(key);
+    if (slot) {
+        if (slot->book && !book) removed++;
+        else if (!slot->book && book) removed--;
+        slot->book = book;
+    } else if (book) {
+        overflow[key] = book;
+    } else {
+        overflow.erase(key);
+    }
+}
+
+void PerfectHashIndex::edit(uint64_t key, Book* book) {
+    if (nextReady.load(std::memory_order_acquire)) adopt();
+
+    put(key, book);
+    if (builder.joinable())
+        editsSinceCopy.emplace_back(key, book);
+    else if (overflow.size() + removed > std::max(MIN_EDITS, table.slots.size() / 16))
+        startRebuild();
+}
+
+void PerfectHashIndex::insert(const ISBN& key, Book* book) {
+    edit(key.id(), book);
+}
+
+void PerfectHashIndex::remove(const ISBN& key) {
+    edit(key.id(), nullptr);
+}
+
+void PerfectHashIndex::startRebuild() {
+    std::vector<std::pair<uint64_t, Book*>> live;
+    live.reserve(table.slots.size() - removed + overflow.size());
+    for (const Slot& s : table.slots)
+        if (s.book) live.emplace_back(s.key, s.book);
+    live.insert(live.end(), overflow.begin(), overflow.end());
+
+    builder = std::thread([this, live = std::move(live)] {
+        nextBuilt = buildTable(live, next);
+        nextReady.store(true, std::memory_order_release);
+    });
+}
+
+// Swaps in the finished table and replays the edits it missed. A failed
+// build leaves the current table, which has every edit already.
+void PerfectHashIndex::adopt() {
+    builder.join();
+    nextReady = false;
+
+    if (nextBuilt) {
+        table = std::move(next);
+        overflow.clear();
+        removed = 0;
+        for (const auto& e : editsSinceCopy) put(e.first, e.second);
+    }
+    next = Table();
+    editsSinceCopy.clear();
+}
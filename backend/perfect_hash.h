@@ -0,0 +1,85 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include "models.h"
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <cstdint>
+
+/*
+ * ISBN -> Book* lookup by a minimal perfect hash (PTHash-style) over the
+ * catalog as of its last build. A key hashes to one of a few buckets per
+ * twenty keys, the bucket's 16-bit pilot scatters it to a position, and
+ * positions past the end are remapped onto the gaps, so n books fill n
+ * slots exactly. The pilots are small enough to stay in cache, leaving
+ * one miss on the slot itself, which holds the key beside the Book* to
+ * reject ISBNs outside the set.
+ *
+ * Books added since the build go to an overflow map and removed ones leave
+ * an empty slot. Once these pass a sixteenth of the table a new one is
+ * built on a background thread from a copy of the live set; the changes
+ * made meanwhile are replayed onto it when it is adopted, at the next
+ * lookup or edit after it finishes.
+ */
+class PerfectHashIndex {
+private:
+    struct Slot {
+        uint64_t key;
+        Book* book;             // null once removed
+    };
+
+    struct Table {
+        uint64_t seed;
+        uint64_t buckets;
+        uint64_t positions;             // before remapping, >= slots.size()
+        std::vector<uint16_t> pilots;
+        std::vector<uint32_t> remap;    // position - slots.size() -> slot
+        std::vector<Slot> slots;
+
+        Table() : seed(0), buckets(0), positions(0) {}
+    };
+
+    Table table;
+    std::unordered_map<uint64_t, Book*> overflow;
+    size_t removed;                     // slots whose book is gone
+
+    // Background rebuild: the table it is building, whether that is done
+    // (and succeeded), and the edits made since it copied the live set
+    // (a null Book* is a removal).
+    std::thread builder;
+    Table next;
+    std::atomic<bool> nextReady;
+    bool nextBuilt;
+    std::vector<std::pair<uint64_t, Book*>> editsSinceCopy;
+
+    static bool buildTable(const std::vector<std::pair<uint64_t, Book*>>& entries, Table& out);
+    Slot* find(uint64_t key);
+
+    void put(uint64_t key, Book* book);     // null book removes
+    void edit(uint64_t key, Book* book);    // put, then log it or rebuild
+    void startRebuild();
+    void adopt();
+
+public:
+    PerfectHashIndex();
+    ~PerfectHashIndex();
+
+    PerfectHashIndex(const PerfectHashIndex&) = delete;
+    PerfectHashIndex& operator=(const PerfectHashIndex&) = delete;
+
+    // Builds over books (distinct ISBNs) in the calling thread, replacing
+    // everything; a running rebuild is waited for and discarded. Throws
+    // std::runtime_error if no hash is found, which in practice is never.
+    void build(const std::vector<Book*>& books);
+
+    void insert(const ISBN& key, Book* book);
+    void remove(const ISBN& key);
+    Book* search(const ISBN& key);
+
+    size_t overflowSize() const { return overflow.size(); }
+};
+
+#endif
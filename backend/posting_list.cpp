@@ -0,0 +1,102 @@
+#include "posting_list.h"
+#include <algorithm>
+
+PostingList::PostingList() : lastID(0), count(0) {}
+
+void PostingList::appendVarint(uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+void PostingList::add(uint32_t docID) {
+    if (count > 0 && docID <= lastID) {
+        if (docID == lastID) return;
+
+        std::vector<uint32_t> ids = decode();
+        auto it = std::lower_bound(ids.begin(), ids.end(), docID);
+        if (it != ids.end() && *it == docID) return;
+        ids.insert(it, docID);
+
+        bytes.clear();
+        count = 0;
+        for (uint32_t id : ids) add(id);
+        return;
+    }
+
+    appendVarint(count == 0 ? docID : docID - lastID);
+    lastID = docID;
+    count++;
+}
+
+void PostingList::assignEncoded(const uint8_t* data, size_t length, uint32_t n, uint32_t last) {
+    bytes.assign(data, data + length);
+    count = n;
+    lastID = last;
+}
+
+void PostingList::remove(uint32_t docID) {
+    std::vector<uint32_t> ids = decode();
+    auto it = std::lower_bound(ids.begin(), ids.end(), docID);
+    if (it == ids.end() || *it != docID) return;
+    ids.erase(it);
+
+    bytes.clear();
+    count = 0;
+    for (uint32_t id : ids) add(id);
+}
+
+void PostingList::decodeInto(std::vector<uint32_t>& out) const {
+    uint32_t id = 0;
+    size_t pos = 0;
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t gap = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            byte = bytes[pos++];
+            gap |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        id += gap;
+        out.push_back(id);
+    }
+}
+
+std::vector<uint32_t> PostingList::decode() const {
+    std::vector<uint32_t> out;
+    out.reserve(count);
+    decodeInto(out);
+    return out;
+}
+
+std::vector<uint32_t> intersectGalloping(
+    const std::vector<uint32_t>& a,
+    const std::vector<uint32_t>& b
+) {
+    const std::vector<uint32_t>& small = (a.size() <= b.size()) ? a : b;
+    const std::vector<uint32_t>& large = (a.size() <= b.size()) ? b : a;
+
+    std::vector<uint32_t> out;
+    size_t lo = 0;
+
+    for (uint32_t id : small) {
+        // Gallop from the last match position until we pass id.
+        size_t step = 1;
+        size_t hi = lo;
+        while (hi < large.size() && large[hi] < id) {
+            lo = hi + 1;
+            hi += step;
+            step <<= 1;
+        }
+        if (hi > large.size()) hi = large.size();
+
+        auto it = std::lower_bound(large.begin() + lo, large.begin() + hi, id);
+        lo = it - large.begin();
+        if (lo == large.size()) break;
+        if (large[lo] == id) out.push_back(id);
+    }
+    return out;
+}
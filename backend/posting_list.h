@@ -0,0 +1,48 @@
+#ifndef POSTING_LIST_H
+#define POSTING_LIST_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Sorted list of document IDs stored as varint-encoded gaps.
+ * Appending IDs in increasing order (the normal build path) is O(1);
+ * out-of-order adds fall back to decode + re-encode.
+ */
+class PostingList {
+private:
+    std::vector<uint8_t> bytes;
+    uint32_t lastID;
+    uint32_t count;
+
+    void appendVarint(uint32_t value);
+
+public:
+    PostingList();
+
+    void add(uint32_t docID);
+    void remove(uint32_t docID);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Encoded form, for snapshots.
+    const std::vector<uint8_t>& encoded() const { return bytes; }
+    uint32_t last() const { return lastID; }
+    void assignEncoded(const uint8_t* data, size_t length, uint32_t n, uint32_t last);
+
+    // Appends the IDs in ascending order.
+    void decodeInto(std::vector<uint32_t>& out) const;
+    std::vector<uint32_t> decode() const;
+};
+
+// Intersection of two ascending ID lists. Walks the smaller list and
+// gallops (exponential then binary search) through the larger one, so the
+// cost is O(small * log(large / small)) rather than O(small + large).
+std::vector<uint32_t> intersectGalloping(
+    const std::vector<uint32_t>& a,
+    const std::vector<uint32_t>& b
+);
+
+#endif
@@ -0,0 +1,75 @@
+#include "query_cache.h"
+#include <algorithm>
+#include <iterator>
+
+// 80% of the slots protect entries that were hit at least twice.
+QueryCache::QueryCache(size_t capacity)
+    : probationCapacity(std::max<size_t>(1, capacity / 5)),
+      protectedCapacity(0),
+      hits(0), misses(0), stale(0), evictions(0) {
+    if (capacity > probationCapacity)
+        protectedCapacity = capacity - probationCapacity;
+}
+
+void QueryCache::trimProbation() {
+    while (probation.size() > probationCapacity) {
+        index.erase(probation.back().key);
+        probation.pop_back();
+        evictions++;
+    }
+}
+
+bool QueryCache::lookup(const std::string& key, uint64_t generation, CachedPage& out) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        misses++;
+        return false;
+    }
+
+    auto entry = it->second;
+    if (entry->generation != generation) {
+        (entry->isProtected ? protectedSeg : probation).erase(entry);
+        index.erase(it);
+        stale++;
+        misses++;
+        return false;
+    }
+
+    if (entry->isProtected) {
+        protectedSeg.splice(protectedSeg.begin(), protectedSeg, entry);
+    } else {
+        entry->isProtected = true;
+        protectedSeg.splice(protectedSeg.begin(), probation, entry);
+
+        // Protected overflow falls back to probation rather than out.
+        if (protectedSeg.size() > protectedCapacity) {
+            auto demoted = std::prev(protectedSeg.end());
+            demoted->isProtected = false;
+            probation.splice(probation.begin(), protectedSeg, demoted);
+            trimProbation();
+        }
+    }
+
+    hits++;
+    out = entry->page;
+    return true;
+}
+
+void QueryCache::store(const std::string& key, uint64_t generation, const CachedPage& page) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->generation = generation;
+        it->second->page = page;
+        return;
+    }
+
+    probation.push_front(Entry{ key, generation, page, false });
+    index[key] = probation.begin();
+    trimProbation();
+}
+
+void QueryCache::clear() {
+    probation.clear();
+    protectedSeg.clear();
+    index.clear();
+}
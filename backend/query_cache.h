@@ -0,0 +1,63 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include "models.h"
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+struct CachedPage {
+    std::vector<ScoredDoc> hits;
+    std::string nextCursor;
+};
+
+/*
+ * Segmented LRU cache of search pages. New entries go to the probationary
+ * segment; a second hit promotes them to the protected segment, so a burst
+ * of one-off queries cannot flush the popular prefixes.
+ *
+ * Every entry remembers the index generation it was computed at; lookups
+ * with a newer generation treat it as a miss and drop it.
+ */
+class QueryCache {
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        CachedPage page;
+        bool isProtected;
+    };
+
+    size_t probationCapacity;
+    size_t protectedCapacity;
+
+    std::list<Entry> probation;     // front = most recently used
+    std::list<Entry> protectedSeg;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale;
+    uint64_t evictions;
+
+    void trimProbation();
+
+public:
+    explicit QueryCache(size_t capacity = 1024);
+
+    // Copies the cached page into out; false on a miss or a stale entry.
+    bool lookup(const std::string& key, uint64_t generation, CachedPage& out);
+    void store(const std::string& key, uint64_t generation, const CachedPage& page);
+    void clear();
+
+    size_t size() const { return index.size(); }
+    size_t capacity() const { return probationCapacity + protectedCapacity; }
+    uint64_t hitCount() const { return hits; }
+    uint64_t missCount() const { return misses; }
+    uint64_t staleCount() const { return stale; }
+    uint64_t evictionCount() const { return evictions; }
+};
+
+#endif
@@ -4,15 +4,15 @@
 RecommendationGraph::RecommendationGraph() {}
 RecommendationGraph::~RecommendationGraph() {}
 
-void RecommendationGraph::addEdge(const std::string& a, const std::string& b) {
+void RecommendationGraph::addEdge(const ISBN& a, const ISBN& b) {
     adj[a].push_back(b);
     adj[b].push_back(a);
 }
 
 void RecommendationGraph::buildFromBooks(
-    std::unordered_map<std::string, Book*>& books
+    std::unordered_map<ISBN, Book*>& books
 ) {
-    std::unordered_map<std::string, std::vector<std::string>> byCategory;
+    byCategory.clear();
 
     for (auto& p : books)
         byCategory[p.second->category].push_back(p.first);
@@ -25,23 +25,48 @@ void RecommendationGraph::buildFromBooks(
     }
 }
 
+void RecommendationGraph::addBook(const ISBN& isbn, const std::string& category) {
+    auto& ids = byCategory[category];
+    for (const auto& other : ids)
+        addEdge(isbn, other);
+    ids.push_back(isbn);
+}
+
+void RecommendationGraph::removeBook(const ISBN& isbn, const std::string& category) {
+    auto it = adj.find(isbn);
+    if (it != adj.end()) {
+        for (const auto& next : it->second) {
+            auto& back = adj[next];
+            back.erase(std::remove(back.begin(), back.end(), isbn), back.end());
+        }
+        adj.erase(it);
+    }
+
+    auto cat = byCategory.find(category);
+    if (cat != byCategory.end()) {
+        auto& ids = cat->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), isbn), ids.end());
+        if (ids.empty()) byCategory.erase(cat);
+    }
+}
+
 void RecommendationGraph::bfs(
-    const std::string& start,
+    const ISBN& start,
     int maxDepth,
     std::vector<SearchResult>& out,
-    std::unordered_map<std::string, Book*>& bookMap
+    std::unordered_map<ISBN, Book*>& bookMap
 ) {
-    std::unordered_set<std::string> visited;
-    std::queue<std::pair<std::string, int>> q;
+    std::unordered_set<ISBN> visited;
+    std::queue<std::pair<ISBN, int>> q;
 
     q.push(std::make_pair(start, 0));
     visited.insert(start);
 
     while (!q.empty()) {
-        std::pair<std::string, int> p = q.front();
+        std::pair<ISBN, int> p = q.front();
         q.pop();
 
-        std::string curr = p.first;
+        ISBN curr = p.first;
         int depth = p.second;
 
         if (depth >= maxDepth) continue;
@@ -54,7 +79,6 @@ void RecommendationGraph::bfs(
             if (it != bookMap.end()) {
                 Book* b = it->second;
                 SearchResult r;
-                r.bookID = next;
                 r.isbn = b->isbn;
                 r.title = b->title;
                 r.author = b->author;
@@ -71,20 +95,92 @@ void RecommendationGraph::bfs(
 }
 
 std::vector<SearchResult> RecommendationGraph::getRecommendations(
-    const std::string& isbn,
+    const ISBN& isbn,
     int limit,
-    std::unordered_map<std::string, Book*>& bookMap
+    std::unordered_map<ISBN, Book*>& bookMap
 ) {
     std::vector<SearchResult> results;
     bfs(isbn, 2, results, bookMap);
 
-    std::sort(results.begin(), results.end(),
-        [](const SearchResult& a, const SearchResult& b) {
-            return a.relevanceScore > b.relevanceScore;
-        });
+    std::sort(results.begin(), results.end(), recommendedBefore);
 
     if ((int)results.size() > limit)
         results.resize(limit);
 
     return results;
 }
+
+/* ================= SNAPSHOT ================= */
+
+void RecommendationGraph::writeTo(
+    SnapshotWriter& out,
+    const std::unordered_map<ISBN, Book*>& books
+) const {
+    auto docOf = [&books](const ISBN& isbn) -> int64_t {
+        auto it = books.find(isbn);
+        return it == books.end() ? -1 : it->second->docID;
+    };
+
+    std::vector<uint32_t> keys, offsets(1, 0), targets;
+    for (const auto& p : adj) {
+        int64_t key = docOf(p.first);
+        if (key < 0) continue;      // placeholder left by a lookup of an unknown ISBN
+        keys.push_back(key);
+        for (const auto& next : p.second) {
+            int64_t target = docOf(next);
+            if (target >= 0) targets.push_back(target);
+        }
+        offsets.push_back(targets.size());
+    }
+    out.putArray(keys);
+    out.putArray(offsets);
+    out.putArray(targets);
+
+    out.put<uint32_t>(byCategory.size());
+    for (const auto& cat : byCategory) {
+        std::vector<uint32_t> ids;
+        for (const auto& isbn : cat.second) {
+            int64_t id = docOf(isbn);
+            if (id >= 0) ids.push_back(id);
+        }
+        out.putString(cat.first);
+        out.putArray(ids);
+    }
+}
+
+void RecommendationGraph::readFrom(SnapshotCursor in, const std::vector<Book*>& docs) {
+    auto isbnOf = [&docs](uint32_t id) -> const ISBN& {
+        if (id >= docs.size() || !docs[id])
+            throw std::runtime_error("Snapshot graph references a missing book");
+        return docs[id]->isbn;
+    };
+
+    size_t keyCount, offsetCount, targetCount;
+    const uint32_t* keys = in.array<uint32_t>(keyCount);
+    const uint32_t* offsets = in.array<uint32_t>(offsetCount);
+    const uint32_t* targets = in.array<uint32_t>(targetCount);
+    if (offsetCount != keyCount + 1)
+        throw std::runtime_error("Snapshot graph is inconsistent");
+
+    adj.clear();
+    adj.reserve(keyCount);
+    for (size_t k = 0; k < keyCount; k++) {
+        if (offsets[k] > offsets[k + 1] || offsets[k + 1] > targetCount)
+            throw std::runtime_error("Snapshot graph is inconsistent");
+        auto& list = adj[isbnOf(keys[k])];
+        list.reserve(offsets[k + 1] - offsets[k]);
+        for (uint32_t e = offsets[k]; e < offsets[k + 1]; e++)
+            list.push_back(isbnOf(targets[e]));
+    }
+
+    byCategory.clear();
+    uint32_t categories = in.get<uint32_t>();
+    for (uint32_t c = 0; c < categories; c++) {
+        std::string name = in.getString();
+        size_t n;
+        const uint32_t* ids = in.array<uint32_t>(n);
+        auto& list = byCategory[name];
+        for (size_t k = 0; k < n; k++)
+            list.push_back(isbnOf(ids[k]));
+    }
+}
@@ -2,6 +2,7 @@
 #define RECOMMENDATION_GRAPH_H
 
 #include "models.h"
+#include "snapshot.h"
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -9,28 +10,38 @@
 
 class RecommendationGraph {
 private:
-    std::unordered_map<std::string, std::vector<std::string>> adj;
+    std::unordered_map<ISBN, std::vector<ISBN>> adj;
+    std::unordered_map<std::string, std::vector<ISBN>> byCategory;
 
     void bfs(
-        const std::string& start,
+        const ISBN& start,
         int maxDepth,
         std::vector<SearchResult>& out,
-        std::unordered_map<std::string, Book*>& bookMap
+        std::unordered_map<ISBN, Book*>& bookMap
     );
 
 public:
     RecommendationGraph();
     ~RecommendationGraph();
 
-    void addEdge(const std::string& a, const std::string& b);
+    void addEdge(const ISBN& a, const ISBN& b);
 
     // NEW – used by LibraryEngine
-    void buildFromBooks(std::unordered_map<std::string, Book*>& books);
+    void buildFromBooks(std::unordered_map<ISBN, Book*>& books);
+
+    // Incremental catalog changes: join / leave the category clique.
+    void addBook(const ISBN& isbn, const std::string& category);
+    void removeBook(const ISBN& isbn, const std::string& category);
+
+    // Stored as CSR adjacency over doc IDs, keeping neighbour order so
+    // traversal results are unchanged. readFrom expects the doc table loaded.
+    void writeTo(SnapshotWriter& out, const std::unordered_map<ISBN, Book*>& books) const;
+    void readFrom(SnapshotCursor in, const std::vector<Book*>& docs);
 
     std::vector<SearchResult> getRecommendations(
-        const std::string& isbn,
+        const ISBN& isbn,
         int limit,
-        std::unordered_map<std::string, Book*>& bookMap
+        std::unordered_map<ISBN, Book*>& bookMap
     );
 };
 
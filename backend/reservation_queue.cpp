@@ -0,0 +1,110 @@
+#include "reservation_queue.h"
+#include <algorithm>
+
+bool ReservationQueue::below(const Node& a, const Node& b) {
+    ReservationCompare compare;
+    if (compare(a.reservation, b.reservation)) return true;
+    if (compare(b.reservation, a.reservation)) return false;
+    return a.order > b.order;
+}
+
+void ReservationQueue::place(size_t i, const Node& n) {
+    heap[i] = n;
+    slot[n.reservation] = i;
+}
+
+void ReservationQueue::siftUp(size_t i) {
+    Node n = heap[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / ARITY;
+        if (!below(heap[parent], n)) break;
+        place(i, heap[parent]);
+        i = parent;
+    }
+    place(i, n);
+}
+
+void ReservationQueue::siftDown(size_t i) {
+    Node n = heap[i];
+    for (;;) {
+        size_t first = i * ARITY + 1;
+        if (first >= heap.size()) break;
+
+        size_t best = first;
+        size_t last = std::min(first + ARITY, heap.size());
+        for (size_t c = first + 1; c < last; c++)
+            if (below(heap[best], heap[c])) best = c;
+
+        if (!below(n, heap[best])) break;
+        place(i, heap[best]);
+        i = best;
+    }
+    place(i, n);
+}
+
+void ReservationQueue::push(Reservation* r) {
+    heap.push_back({ r, pushed++ });
+    siftUp(heap.size() - 1);
+}
+
+Reservation* ReservationQueue::pop() {
+    Reservation* r = heap.front().reservation;
+    erase(r);
+    return r;
+}
+
+bool ReservationQueue::erase(const Reservation* r) {
+    auto it = slot.find(r);
+    if (it == slot.end()) return false;
+
+    size_t i = it->second;
+    slot.erase(it);
+
+    Node last = heap.back();
+    heap.pop_back();
+    if (i == heap.size()) return true;
+
+    // The moved entry may belong above or below the hole.
+    place(i, last);
+    siftUp(i);
+    siftDown(slot[last.reservation]);
+    return true;
+}
+
+void ReservationQueue::update(const Reservation* r) {
+    auto it = slot.find(r);
+    if (it == slot.end()) return;
+    siftUp(it->second);
+    siftDown(slot[r]);
+}
+
+size_t ReservationQueue::position(const Reservation* r) const {
+    auto it = slot.find(r);
+    if (it == slot.end()) return 0;
+    const Node& target = heap[it->second];
+
+    size_t ahead = 0;
+    std::vector<size_t> pending(1, 0);
+    while (!pending.empty()) {
+        size_t i = pending.back();
+        pending.pop_back();
+        if (!below(target, heap[i])) continue;
+
+        ahead++;
+        size_t first = i * ARITY + 1;
+        size_t last = std::min(first + ARITY, heap.size());
+        for (size_t c = first; c < last; c++)
+            pending.push_back(c);
+    }
+    return ahead + 1;
+}
+
+std::vector<Reservation*> ReservationQueue::ordered() const {
+    std::vector<Node> nodes = heap;
+    std::sort(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) { return below(b, a); });
+
+    std::vector<Reservation*> out;
+    out.reserve(nodes.size());
+    for (const Node& n : nodes) out.push_back(n.reservation);
+    return out;
+}
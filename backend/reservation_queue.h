@@ -0,0 +1,75 @@
+#ifndef RESERVATION_QUEUE_H
+#define RESERVATION_QUEUE_H
+
+#include "models.h"
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// a ranks below b: lower priority score, then the later reservation.
+struct ReservationCompare {
+    bool operator()(const Reservation* a, const Reservation* b) const {
+        if (a->priorityScore != b->priorityScore)
+            return a->priorityScore < b->priorityScore;
+        return a->timestamp > b->timestamp;
+    }
+};
+
+/*
+ * Reservations for one book, served highest priority first: an indexed
+ * 4-ary max-heap. Every entry's slot is tracked, so a reservation can be
+ * cancelled or re-prioritized in O(log n) instead of rebuilding the queue.
+ * A wider node keeps the heap shallow and its children close together.
+ * Reservations that tie on ReservationCompare are served in the order
+ * they were pushed.
+ *
+ * The queue does not own its reservations.
+ */
+class ReservationQueue {
+private:
+    static const size_t ARITY = 4;
+
+    struct Node {
+        Reservation* reservation;
+        uint64_t order;         // push order, breaks ties
+    };
+
+    std::vector<Node> heap;
+    std::unordered_map<const Reservation*, size_t> slot;
+    uint64_t pushed;
+
+    static bool below(const Node& a, const Node& b);
+    void place(size_t i, const Node& n);
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+
+public:
+    ReservationQueue() : pushed(0) {}
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+    bool contains(const Reservation* r) const { return slot.count(r) != 0; }
+
+    // Next reservation to serve. The queue must not be empty.
+    Reservation* top() const { return heap.front().reservation; }
+
+    void push(Reservation* r);
+    Reservation* pop();
+
+    // Removes r; false if it is not queued here.
+    bool erase(const Reservation* r);
+
+    // Restores order after r's priorityScore or timestamp changed.
+    void update(const Reservation* r);
+
+    // 1-based place of r in serving order (0 if not queued). Visits only
+    // the entries ahead of it: a subtree whose root ranks below r holds
+    // nothing that does.
+    size_t position(const Reservation* r) const;
+
+    // Every queued reservation in serving order. O(n log n).
+    std::vector<Reservation*> ordered() const;
+};
+
+#endif
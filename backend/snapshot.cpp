@@ -0,0 +1,121 @@
+#include "snapshot.h"
+#include "atomic_file.h"
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'L', 'I', 'B', 'S', 'N', 'A', 'P', '\0' };
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t tableOffset;
+    uint64_t fileSize;
+    uint32_t checksum;      // CRC32 of bytes [sizeof header, fileSize)
+    uint32_t reserved;
+};
+
+struct SectionEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+}
+
+/* ================= WRITER ================= */
+
+SnapshotWriter::SnapshotWriter() : buffer(sizeof(SnapshotHeader), 0) {}
+
+void SnapshotWriter::align() {
+    buffer.resize((buffer.size() + 7) & ~size_t(7), 0);
+}
+
+void SnapshotWriter::write(const void* data, size_t length) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    buffer.insert(buffer.end(), p, p + length);
+}
+
+void SnapshotWriter::endSection() {
+    if (!sections.empty() && sections.back().size == 0)
+        sections.back().size = buffer.size() - sections.back().offset;
+}
+
+void SnapshotWriter::beginSection(SnapshotSection id) {
+    endSection();
+    align();
+    sections.push_back({ id, 0, buffer.size(), 0 });
+}
+
+void SnapshotWriter::commit(const std::string& path) {
+    endSection();
+    align();
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof header.magic);
+    header.version = SNAPSHOT_VERSION;
+    header.sectionCount = sections.size();
+    header.tableOffset = buffer.size();
+
+    for (const Section& s : sections) {
+        SectionEntry e = { s.id, 0, s.offset, s.size };
+        write(&e, sizeof e);
+    }
+
+    header.fileSize = buffer.size();
+    header.checksum = crc32(buffer.data() + sizeof header, buffer.size() - sizeof header);
+    header.reserved = 0;
+    std::memcpy(buffer.data(), &header, sizeof header);
+
+    // The journal segments it covers are deleted once this returns, so the
+    // snapshot must be durably in place, never missing, by then.
+    if (!writeFileAtomically(path, buffer.data(), buffer.size()))
+        throw std::runtime_error("Cannot write " + path);
+}
+
+/* ================= READER ================= */
+
+const uint8_t* SnapshotCursor::take(size_t length) {
+    if (pos > end || length > end - pos)
+        throw std::runtime_error("Snapshot section overrun");
+    const uint8_t* p = base + pos;
+    pos += length;
+    return p;
+}
+
+SnapshotReader::SnapshotReader(const MappedFile& file)
+    : base(file.data()), length(file.size()) {
+    SnapshotHeader header;
+    if (length < sizeof header)
+        throw std::runtime_error("Snapshot truncated");
+    std::memcpy(&header, base, sizeof header);
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof header.magic) != 0)
+        throw std::runtime_error("Not a snapshot file");
+    if (header.version != SNAPSHOT_VERSION)
+        throw std::runtime_error("Unsupported snapshot version");
+    if (header.fileSize != length)
+        throw std::runtime_error("Snapshot truncated");
+    if (crc32(base + sizeof header, length - sizeof header) != header.checksum)
+        throw std::runtime_error("Snapshot checksum mismatch");
+
+    uint64_t tableSize = uint64_t(header.sectionCount) * sizeof(SectionEntry);
+    if (header.tableOffset > length || tableSize > length - header.tableOffset)
+        throw std::runtime_error("Snapshot section table out of range");
+
+    for (uint32_t k = 0; k < header.sectionCount; k++) {
+        SectionEntry e;
+        std::memcpy(&e, base + header.tableOffset + k * sizeof e, sizeof e);
+        if (e.offset > header.tableOffset || e.size > header.tableOffset - e.offset)
+            throw std::runtime_error("Snapshot section out of range");
+        ids.push_back(e.id);
+        cursors.emplace_back(base, e.offset, e.size);
+    }
+}
+
+SnapshotCursor SnapshotReader::section(SnapshotSection id) const {
+    for (size_t k = 0; k < ids.size(); k++)
+        if (ids[k] == id) return cursors[k];
+    throw std::runtime_error("Snapshot section missing");
+}
@@ -0,0 +1,151 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "mapped_file.h"
+#include "crc32.h"
+
+/*
+ * Versioned binary snapshot of the catalog and its indexes.
+ *
+ * Layout: a fixed header, the section payloads, then a section table. Every
+ * reference inside the file is an offset or an index, never a pointer, so a
+ * snapshot is position-independent and can be used straight from a
+ * read-only mapping. Arrays are stored as a uint64 element count followed
+ * by the raw elements, aligned to 8 bytes from the start of the file.
+ *
+ * The header carries the payload size and a CRC32 of everything after it;
+ * a truncated, corrupt or foreign file is rejected with std::runtime_error.
+ */
+
+const uint32_t SNAPSHOT_VERSION = 9;
+
+enum SnapshotSection : uint32_t {
+    SNAP_STRINGS = 1,
+    SNAP_CATALOG,
+    SNAP_ISBN_INDEX,
+    SNAP_TITLE_TRIE,
+    SNAP_AUTHOR_TRIE,
+    SNAP_SUBSTRING,
+    SNAP_GRAPH,
+    SNAP_CIRCULATION,
+    SNAP_USERS,
+    SNAP_COPIES,
+    SNAP_SOURCE
+};
+
+class SnapshotWriter {
+private:
+    struct Section {
+        uint32_t id;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    std::vector<uint8_t> buffer;        // whole file, header included
+    std::vector<Section> sections;
+
+    void align();
+    void endSection();
+
+public:
+    SnapshotWriter();
+
+    void beginSection(SnapshotSection id);
+    void write(const void* data, size_t length);
+
+    template <class T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be plain data");
+        write(&value, sizeof value);
+    }
+
+    template <class T>
+    void putArray(const T* items, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be plain data");
+        put<uint64_t>(count);
+        align();
+        write(items, count * sizeof(T));
+    }
+
+    template <class T>
+    void putArray(const std::vector<T>& items) { putArray(items.data(), items.size()); }
+
+    void putString(const std::string& s) { putArray(s.data(), s.size()); }
+
+    // Replaces path atomically and durably (see writeFileAtomically).
+    // Throws std::runtime_error.
+    void commit(const std::string& path);
+};
+
+// Bounds-checked reader over one section of a mapped snapshot.
+class SnapshotCursor {
+private:
+    const uint8_t* base;    // start of the file; alignment is relative to it
+    size_t pos;
+    size_t end;
+
+    const uint8_t* take(size_t length);
+
+public:
+    SnapshotCursor(const uint8_t* fileBase, size_t offset, size_t size)
+        : base(fileBase), pos(offset), end(offset + size) {}
+
+    template <class T>
+    T get() {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be plain data");
+        T value;
+        std::memcpy(&value, take(sizeof value), sizeof value);
+        return value;
+    }
+
+    // Pointer into the mapping; valid while the MappedFile lives.
+    template <class T>
+    const T* array(size_t& count) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot arrays must be plain data");
+        uint64_t n = get<uint64_t>();
+        pos = (pos + 7) & ~size_t(7);
+        if (pos > end || n > (end - pos) / sizeof(T))
+            throw std::runtime_error("Snapshot section overrun");
+        count = n;
+        return reinterpret_cast<const T*>(take(n * sizeof(T)));
+    }
+
+    template <class T>
+    void getArray(std::vector<T>& out) {
+        size_t n;
+        const T* items = array<T>(n);
+        out.assign(items, items + n);
+    }
+
+    std::string getString() {
+        size_t n;
+        const char* s = array<char>(n);
+        return std::string(s, n);
+    }
+};
+
+class SnapshotReader {
+private:
+    const uint8_t* base;
+    size_t length;
+    std::vector<SnapshotCursor> cursors;
+    std::vector<uint32_t> ids;
+
+public:
+    // Validates header, version, size and checksum.
+    explicit SnapshotReader(const MappedFile& file);
+
+    // Throws std::runtime_error if the section is missing.
+    SnapshotCursor section(SnapshotSection id) const;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "suffix_array.h"
+#include "inverted_index.h"
+#include <algorithm>
+#include <cctype>
+
+SuffixArray::SuffixArray(const std::vector<Book*>& docTable) : docs(docTable) {}
+
+std::string SuffixArray::normalize(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (std::isspace(u)) {
+            if (!out.empty() && out.back() != ' ') out += ' ';
+        } else {
+            out += static_cast<char>(std::tolower(u));
+        }
+    }
+    if (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+void SuffixArray::appendSegment(const std::string& field, uint32_t docID, uint8_t fieldBit) {
+    segStart.push_back(text.size());
+    segDoc.push_back(docID);
+    segField.push_back(fieldBit);
+    text += normalize(field);
+    text += '\n';
+}
+
+void SuffixArray::build() {
+    text.clear();
+    segStart.clear();
+    segDoc.clear();
+    segField.clear();
+
+    for (const Book* b : docs) {
+        if (!b) continue;
+        appendSegment(b->title, b->docID, FIELD_TITLE);
+        appendSegment(b->author, b->docID, FIELD_AUTHOR);
+    }
+    segStart.push_back(text.size());
+
+    stale.assign(docs.size(), 0);
+    pending.clear();
+
+    sortSuffixes();
+}
+
+void SuffixArray::removeDocument(uint32_t docID) {
+    if (stale.size() <= docID) stale.resize(docID + 1, 0);
+    stale[docID] = 1;
+
+    pending.erase(std::remove_if(pending.begin(), pending.end(),
+        [docID](const PendingDoc& p) { return p.docID == docID; }),
+        pending.end());
+}
+
+void SuffixArray::addDocument(uint32_t docID) {
+    removeDocument(docID);
+
+    const Book* b = docs[docID];
+    pending.push_back({ docID, normalize(b->title), normalize(b->author) });
+
+    if (pending.size() > std::max<size_t>(64, segDoc.size() / 32))
+        build();
+}
+
+// Prefix doubling: after the round for step k, rank[i] orders suffixes by
+// their first 2k characters. Each round is two stable counting-sort passes
+// (second key, then first key), so the build is O(n log n).
+void SuffixArray::sortSuffixes() {
+    const size_t n = text.size();
+    sa.assign(n, 0);
+    if (n == 0) return;
+
+    std::vector<uint32_t> rank(n), tmp(n), order(n);
+    for (size_t i = 0; i < n; i++) {
+        sa[i] = i;
+        rank[i] = static_cast<unsigned char>(text[i]) + 1;
+    }
+
+    size_t classes = 257;
+    std::vector<uint32_t> count;
+
+    for (size_t k = 1;; k <<= 1) {
+        // Rank of the second half; 0 sorts suffixes that run off the end first.
+        auto second = [&](uint32_t i) { return i + k < n ? rank[i + k] : 0u; };
+
+        count.assign(classes + 1, 0);
+        for (size_t i = 0; i < n; i++) count[second(i)]++;
+        for (size_t c = 1; c <= classes; c++) count[c] += count[c - 1];
+        for (size_t i = n; i-- > 0;) order[--count[second(i)]] = i;
+
+        count.assign(classes + 1, 0);
+        for (size_t i = 0; i < n; i++) count[rank[i]]++;
+        for (size_t c = 1; c <= classes; c++) count[c] += count[c - 1];
+        for (size_t i = n; i-- > 0;) sa[--count[rank[order[i]]]] = order[i];
+
+        tmp[sa[0]] = 1;
+        for (size_t i = 1; i < n; i++) {
+            bool same = rank[sa[i]] == rank[sa[i - 1]] && second(sa[i]) == second(sa[i - 1]);
+            tmp[sa[i]] = tmp[sa[i - 1]] + (same ? 0 : 1);
+        }
+        rank.swap(tmp);
+        classes = rank[sa[n - 1]];
+
+        if (classes == n || k >= n) break;
+    }
+}
+
+// First suffix >= pattern (upper = false) or first suffix that does not
+// start with pattern and sorts after it (upper = true).
+size_t SuffixArray::bound(const std::string& pattern, bool upper) const {
+    size_t lo = 0, hi = sa.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = text.compare(sa[mid], pattern.size(), pattern);
+        if (cmp < 0 || (upper && cmp == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+std::vector<uint32_t> SuffixArray::find(const std::string& pattern, unsigned fields) const {
+    std::string p = normalize(pattern);
+    if (p.empty()) return {};
+
+    size_t lo = bound(p, false);
+    size_t hi = bound(p, true);
+
+    std::vector<uint32_t> ids;
+    for (size_t i = lo; i < hi; i++) {
+        size_t seg = std::upper_bound(segStart.begin(), segStart.end(), sa[i]) - segStart.begin() - 1;
+        if ((segField[seg] & fields) && !stale[segDoc[seg]]) ids.push_back(segDoc[seg]);
+    }
+
+    for (const auto& d : pending) {
+        if (((fields & FIELD_TITLE) && d.title.find(p) != std::string::npos) ||
+            ((fields & FIELD_AUTHOR) && d.author.find(p) != std::string::npos))
+            ids.push_back(d.docID);
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+/* ================= SNAPSHOT ================= */
+
+void SuffixArray::writeTo(SnapshotWriter& out) {
+    if (!pending.empty() || std::count(stale.begin(), stale.end(), 1) > 0)
+        build();
+
+    out.putString(text);
+    out.putArray(sa);
+    out.putArray(segStart);
+    out.putArray(segDoc);
+    out.putArray(segField);
+}
+
+void SuffixArray::readFrom(SnapshotCursor in) {
+    text = in.getString();
+    in.getArray(sa);
+    in.getArray(segStart);
+    in.getArray(segDoc);
+    in.getArray(segField);
+
+    if (sa.size() != text.size() || segStart.size() != segDoc.size() + 1 ||
+        segField.size() != segDoc.size() ||
+        std::any_of(segDoc.begin(), segDoc.end(), [this](uint32_t d) { return d >= docs.size(); }))
+        throw std::runtime_error("Snapshot suffix array is inconsistent");
+
+    stale.assign(docs.size(), 0);
+    pending.clear();
+}
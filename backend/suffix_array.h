@@ -0,0 +1,64 @@
+#ifndef SUFFIX_ARRAY_H
+#define SUFFIX_ARRAY_H
+
+#include "models.h"
+#include "snapshot.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/*
+ * Suffix array over the normalized (lowercased, whitespace-collapsed) title
+ * and author of every book, for infix queries such as "script" matching
+ * "JavaScript". Each field is its own '\n'-terminated segment, so matches
+ * never span two fields or two books.
+ */
+class SuffixArray {
+private:
+    const std::vector<Book*>& docs;
+
+    std::string text;
+    std::vector<uint32_t> sa;
+
+    // Segment k covers text[segStart[k], segStart[k + 1]).
+    std::vector<uint32_t> segStart;
+    std::vector<uint32_t> segDoc;
+    std::vector<uint8_t> segField;      // FIELD_TITLE or FIELD_AUTHOR
+
+    // Runtime catalog changes: docs whose text in the array is outdated are
+    // masked out, and added/updated docs are scanned linearly until the
+    // pending set is large enough to justify a rebuild.
+    struct PendingDoc {
+        uint32_t docID;
+        std::string title;
+        std::string author;
+    };
+    std::vector<uint8_t> stale;         // [docID]
+    std::vector<PendingDoc> pending;
+
+    void appendSegment(const std::string& field, uint32_t docID, uint8_t fieldBit);
+    void sortSuffixes();
+    size_t bound(const std::string& pattern, bool upper) const;
+
+public:
+    explicit SuffixArray(const std::vector<Book*>& docTable);
+
+    static std::string normalize(const std::string& s);
+
+    // Rebuilds over every book in the doc table.
+    void build();
+
+    void addDocument(uint32_t docID);
+    void removeDocument(uint32_t docID);
+
+    // Sorted doc IDs whose selected fields contain pattern; O(m log n)
+    // to locate the match range.
+    std::vector<uint32_t> find(const std::string& pattern, unsigned fields) const;
+
+    // Pending changes are folded in with a rebuild first, so a snapshot
+    // always holds a clean array. readFrom expects the doc table loaded.
+    void writeTo(SnapshotWriter& out);
+    void readFrom(SnapshotCursor in);
+};
+
+#endif
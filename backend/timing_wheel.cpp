@@ -0,0 +1,120 @@
+#include "timing_wheel.h"
+#include <algorithm>
+#include <climits>
+
+TimingWheel::TimingWheel(long long now) : occupied(), current(now), stored(0) {}
+
+void TimingWheel::insert(const Timer& t) {
+    if (t.deadline <= current) {
+        due.push_back(t);
+        return;
+    }
+
+    // Lowest level whose span covers the distance; its slot is picked by the
+    // deadline itself, so the entry is cascaded exactly when its block starts.
+    unsigned long long delta = t.deadline - current;
+    for (unsigned level = 0; level < LEVELS; level++) {
+        if ((delta >> (SLOT_BITS * (level + 1))) == 0) {
+            unsigned slot = (t.deadline >> (SLOT_BITS * level)) & (SLOTS - 1);
+            slots[level][slot].push_back(t);
+            occupied[level] |= 1ULL << slot;
+            stored++;
+            return;
+        }
+    }
+    overflow.push_back(t);
+    stored++;
+}
+
+// First tick after current at which a non-empty slot fires or cascades.
+long long TimingWheel::nextTick() const {
+    long long next = LLONG_MAX;
+    for (unsigned level = 0; level < LEVELS; level++) {
+        if (!occupied[level]) continue;
+
+        // Slot of the next block at this level, then the first occupied
+        // slot from there on, wrapping around.
+        unsigned shift = SLOT_BITS * level;
+        long long block = (current >> shift) + 1;
+        unsigned from = block & (SLOTS - 1);
+        uint64_t rotated = from ? (occupied[level] >> from) | (occupied[level] << (SLOTS - from))
+                                : occupied[level];
+        next = std::min(next, (block + __builtin_ctzll(rotated)) << shift);
+    }
+    if (!overflow.empty()) {
+        unsigned shift = SLOT_BITS * LEVELS;
+        next = std::min(next, ((current >> shift) + 1) << shift);
+    }
+    return next;
+}
+
+void TimingWheel::cascade(std::vector<Timer>& slot) {
+    std::vector<Timer> moving;
+    moving.swap(slot);
+    stored -= moving.size();
+    for (const Timer& t : moving) {
+        auto it = live.find(t.id);
+        if (it != live.end() && it->second == t.deadline) insert(t);
+    }
+}
+
+void TimingWheel::fire(std::vector<Timer>& slot, std::vector<uint64_t>& expired) {
+    std::vector<Timer> firing;
+    firing.swap(slot);
+    if (&slot != &due) stored -= firing.size();
+    for (const Timer& t : firing) {
+        auto it = live.find(t.id);
+        if (it == live.end() || it->second != t.deadline) continue;   // cancelled or moved
+        live.erase(it);
+        expired.push_back(t.id);
+    }
+}
+
+void TimingWheel::schedule(uint64_t id, long long deadline) {
+    live[id] = deadline;
+    insert({ id, deadline });
+}
+
+void TimingWheel::cancel(uint64_t id) {
+    live.erase(id);
+}
+
+void TimingWheel::advance(long long now, std::vector<uint64_t>& expired) {
+    fire(due, expired);
+
+    while (current < now) {
+        if (live.empty()) {
+            // Only cancelled entries remain; drop them rather than walk them.
+            if (stored > 0) {
+                for (auto& level : slots)
+                    for (auto& slot : level) slot.clear();
+                std::fill(occupied, occupied + LEVELS, 0);
+                overflow.clear();
+                stored = 0;
+            }
+            current = now;
+            break;
+        }
+
+        long long tick = nextTick();
+        if (tick > now) {
+            current = now;
+            break;
+        }
+        current = tick;
+
+        for (unsigned level = 1; level < LEVELS; level++) {
+            if (tick & ((1LL << (SLOT_BITS * level)) - 1)) break;
+            unsigned slot = (tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+            cascade(slots[level][slot]);
+            if (slots[level][slot].empty()) occupied[level] &= ~(1ULL << slot);
+            if (level == LEVELS - 1 && (tick & ((1LL << (SLOT_BITS * LEVELS)) - 1)) == 0)
+                cascade(overflow);
+        }
+
+        unsigned slot = tick & (SLOTS - 1);
+        fire(slots[0][slot], expired);
+        occupied[0] &= ~(1ULL << slot);
+        fire(due, expired);     // cascaded entries due this very tick
+    }
+}
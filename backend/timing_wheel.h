@@ -0,0 +1,60 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Hierarchical timing wheel with one-second ticks: four levels of 64 slots,
+ * each slot of level k spanning 64^k seconds, so deadlines up to ~194 days
+ * out are placed in O(1) and anything later waits in an overflow list. A
+ * slot of level k is cascaded into the levels below when the wheel reaches
+ * its start, which makes each timer cost O(levels) over its life however
+ * many are pending. Ticks with nothing in any slot are skipped using a
+ * bitmap of occupied slots per level, so a long idle stretch costs no more
+ * than the timers that come due in it.
+ *
+ * Timers are identified by the caller's 64-bit ID. cancel() is O(1): the
+ * entry stays in its slot and is skipped when the slot comes up.
+ */
+class TimingWheel {
+private:
+    static const unsigned LEVELS = 4;
+    static const unsigned SLOT_BITS = 6;
+    static const unsigned SLOTS = 1u << SLOT_BITS;
+
+    struct Timer {
+        uint64_t id;
+        long long deadline;
+    };
+
+    std::vector<Timer> slots[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS];      // bit s: slots[level][s] is non-empty
+    std::vector<Timer> overflow;    // beyond the top level's reach
+    std::vector<Timer> due;         // scheduled at or before current
+    std::unordered_map<uint64_t, long long> live;   // id -> deadline
+    long long current;              // last tick processed
+    size_t stored;                  // entries in slots, cancelled ones included
+
+    void insert(const Timer& t);
+    long long nextTick() const;
+    void cascade(std::vector<Timer>& slot);
+    void fire(std::vector<Timer>& slot, std::vector<uint64_t>& expired);
+
+public:
+    explicit TimingWheel(long long now);
+
+    // Schedules (or reschedules) id for the given time in seconds.
+    void schedule(uint64_t id, long long deadline);
+    void cancel(uint64_t id);
+
+    // Moves the wheel to now and appends the IDs that came due, earliest
+    // tick first. A wheel with nothing pending jumps straight there.
+    void advance(long long now, std::vector<uint64_t>& expired);
+
+    size_t size() const { return live.size(); }
+};
+
+#endif
@@ -2,13 +2,12 @@
 #include <algorithm>
 #include <cctype>
 
-AdaptiveTrie::AdaptiveTrie() {
-    root = new TrieNode();
+AdaptiveTrie::AdaptiveTrie(const std::vector<Book*>& docTable)
+    : docs(docTable) {
+    newNode(0, 0);
 }
 
-AdaptiveTrie::~AdaptiveTrie() {
-    deleteNode(root);
-}
+AdaptiveTrie::~AdaptiveTrie() {}
 
 int AdaptiveTrie::idx(char c) {
     c = std::tolower(static_cast<unsigned char>(c));
@@ -16,84 +15,457 @@ int AdaptiveTrie::idx(char c) {
     return c - 'a';
 }
 
-void AdaptiveTrie::deleteNode(TrieNode* node) {
-    if (!node) return;
-    for (int i = 0; i < 26; i++)
-        deleteNode(node->children[i]);
-    delete node;
-}
-
-void AdaptiveTrie::insert(const std::string& word, const std::string& bookID) {
-    TrieNode* curr = root;
+std::string AdaptiveTrie::normalize(const std::string& word) {
+    std::string key;
+    key.reserve(word.size());
     for (char c : word) {
         int i = idx(c);
-        if (i < 0) continue;
-        if (!curr->children[i])
-            curr->children[i] = new TrieNode();
-        curr = curr->children[i];
+        if (i >= 0) key += static_cast<char>('a' + i);
+    }
+    return key;
+}
+
+/* ================= ARENA / CHILD ENCODING ================= */
+
+uint32_t AdaptiveTrie::childCount(const TrieNode& node) const {
+    return __builtin_popcount(node.childMask);
+}
+
+int32_t AdaptiveTrie::findChild(uint32_t node, int letter) const {
+    const TrieNode& n = nodes[node];
+    uint32_t bit = 1u << letter;
+    if (!(n.childMask & bit)) return -1;
+    return childSlots[n.childBase + __builtin_popcount(n.childMask & (bit - 1))];
+}
+
+uint32_t AdaptiveTrie::allocBlock(uint32_t size) {
+    if (size < freeBlocks.size() && !freeBlocks[size].empty()) {
+        uint32_t base = freeBlocks[size].back();
+        freeBlocks[size].pop_back();
+        return base;
+    }
+    uint32_t base = childSlots.size();
+    childSlots.resize(base + size);
+    return base;
+}
+
+void AdaptiveTrie::addChild(uint32_t node, int letter, uint32_t child) {
+    uint32_t count = childCount(nodes[node]);
+    uint32_t oldBase = nodes[node].childBase;
+    uint32_t newBase = allocBlock(count + 1);
+
+    uint32_t bit = 1u << letter;
+    uint32_t pos = __builtin_popcount(nodes[node].childMask & (bit - 1));
+
+    for (uint32_t k = 0; k < pos; k++)
+        childSlots[newBase + k] = childSlots[oldBase + k];
+    childSlots[newBase + pos] = child;
+    for (uint32_t k = pos; k < count; k++)
+        childSlots[newBase + k + 1] = childSlots[oldBase + k];
+
+    if (count > 0) {
+        if (freeBlocks.size() <= count) freeBlocks.resize(count + 1);
+        freeBlocks[count].push_back(oldBase);
     }
-    curr->isEnd = true;
-    curr->bookIDs.insert(bookID);
+
+    nodes[node].childMask |= bit;
+    nodes[node].childBase = newBase;
+}
+
+void AdaptiveTrie::replaceChild(uint32_t node, int letter, uint32_t child) {
+    const TrieNode& n = nodes[node];
+    uint32_t bit = 1u << letter;
+    childSlots[n.childBase + __builtin_popcount(n.childMask & (bit - 1))] = child;
+}
+
+uint32_t AdaptiveTrie::newNode(uint32_t labelStart, uint32_t labelLength) {
+    nodes.emplace_back(labelStart, labelLength);
+    topPool.resize(nodes.size() * TOP_K);
+    return nodes.size() - 1;
 }
 
-void AdaptiveTrie::collect(TrieNode* node, std::set<std::string>& result) {
-    if (!node) return;
-    for (auto& id : node->bookIDs)
-        result.insert(id);
-    for (int i = 0; i < 26; i++)
-        collect(node->children[i], result);
+// Cut child's label after `at` characters; the new upper half takes the
+// child's place under parent and inherits its ranking (same subtree).
+uint32_t AdaptiveTrie::splitNode(uint32_t parent, uint32_t child, uint32_t at) {
+    uint32_t mid = newNode(nodes[child].labelStart, at);
+    nodes[mid].topCount = nodes[child].topCount;
+    std::copy_n(&topPool[child * TOP_K], TOP_K, &topPool[mid * TOP_K]);
+
+    nodes[child].labelStart += at;
+    nodes[child].labelLength -= at;
+
+    replaceChild(parent, labels[nodes[mid].labelStart] - 'a', mid);
+    addChild(mid, labels[nodes[child].labelStart] - 'a', child);
+    return mid;
 }
 
-std::vector<SearchResult> AdaptiveTrie::searchPrefix(
+/* ================= INSERT / LOOKUP ================= */
+
+bool AdaptiveTrie::ranksHigher(uint32_t a, uint32_t b) const {
+    return ::ranksHigher(docs[a], docs[b]);
+}
+
+// Scores only ever grow (new books, borrows), so a book is either already
+// in the list and just needs to bubble up, or it displaces the tail.
+void AdaptiveTrie::offerTop(uint32_t node, uint32_t docID) {
+    uint32_t* top = &topPool[node * TOP_K];
+    uint32_t& count = nodes[node].topCount;
+    uint32_t pos = std::find(top, top + count, docID) - top;
+
+    if (pos == count) {
+        if (count == TOP_K) {
+            if (!ranksHigher(docID, top[count - 1])) return;
+            pos = count - 1;
+        } else {
+            count++;
+        }
+        top[pos] = docID;
+    }
+
+    while (pos > 0 && ranksHigher(top[pos], top[pos - 1])) {
+        std::swap(top[pos], top[pos - 1]);
+        --pos;
+    }
+}
+
+void AdaptiveTrie::insert(const std::string& word, uint32_t docID) {
+    std::string key = normalize(word);
+    uint32_t curr = 0;
+    size_t i = 0;
+
+    offerTop(curr, docID);
+
+    while (i < key.size()) {
+        int32_t child = findChild(curr, key[i] - 'a');
+
+        if (child < 0) {
+            uint32_t start = labels.size();
+            labels.append(key, i, std::string::npos);
+            uint32_t leaf = newNode(start, key.size() - i);
+            addChild(curr, key[i] - 'a', leaf);
+            curr = leaf;
+            offerTop(curr, docID);
+            break;
+        }
+
+        const TrieNode& n = nodes[child];
+        uint32_t l = 0;
+        while (l < n.labelLength && i + l < key.size() &&
+               labels[n.labelStart + l] == key[i + l])
+            l++;
+
+        if (l < n.labelLength)
+            child = splitNode(curr, child, l);
+
+        curr = child;
+        offerTop(curr, docID);
+        i += l;
+    }
+
+    if (nodes[curr].postings < 0) {
+        nodes[curr].postings = postingLists.size();
+        postingLists.emplace_back();
+    }
+    postingLists[nodes[curr].postings].add(docID);
+}
+
+// Recompute a node's list from its own postings and its children's lists;
+// anything in the subtree's top K is in one of those.
+void AdaptiveTrie::rebuildTop(uint32_t node) {
+    std::vector<uint32_t> candidates;
+    const TrieNode& n = nodes[node];
+
+    if (n.postings >= 0)
+        postingLists[n.postings].decodeInto(candidates);
+
+    uint32_t count = childCount(n);
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t child = childSlots[n.childBase + k];
+        const uint32_t* top = &topPool[child * TOP_K];
+        candidates.insert(candidates.end(), top, top + nodes[child].topCount);
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    size_t keep = std::min(TOP_K, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(),
+        [this](uint32_t a, uint32_t b) { return ranksHigher(a, b); });
+    candidates.resize(keep);
+
+    std::copy(candidates.begin(), candidates.end(), &topPool[node * TOP_K]);
+    nodes[node].topCount = keep;
+}
+
+void AdaptiveTrie::remove(const std::string& word, uint32_t docID) {
+    std::string key = normalize(word);
+    std::vector<uint32_t> path(1, 0);
+    size_t i = 0;
+
+    while (i < key.size()) {
+        int32_t child = findChild(path.back(), key[i] - 'a');
+        if (child < 0) return;
+
+        const TrieNode& n = nodes[child];
+        for (uint32_t l = 0; l < n.labelLength; l++, i++)
+            if (i >= key.size() || labels[n.labelStart + l] != key[i]) return;
+        path.push_back(child);
+    }
+
+    TrieNode& end = nodes[path.back()];
+    if (end.postings < 0) return;
+    postingLists[end.postings].remove(docID);
+
+    for (size_t k = path.size(); k-- > 0;)
+        rebuildTop(path[k]);
+}
+
+// Node whose subtree holds exactly the words starting with key, or -1.
+// A key that ends part-way through an edge label resolves to the node
+// below that edge.
+int32_t AdaptiveTrie::findPrefixNode(const std::string& key) {
+    uint32_t curr = 0;
+    size_t i = 0;
+
+    while (i < key.size()) {
+        int32_t child = findChild(curr, key[i] - 'a');
+        if (child < 0) return -1;
+
+        const TrieNode& n = nodes[child];
+        for (uint32_t l = 0; l < n.labelLength && i < key.size(); l++, i++)
+            if (labels[n.labelStart + l] != key[i]) return -1;
+
+        curr = child;
+    }
+    return curr;
+}
+
+void AdaptiveTrie::collect(uint32_t node, std::vector<uint32_t>& result) {
+    const TrieNode& n = nodes[node];
+    if (n.postings >= 0)
+        postingLists[n.postings].decodeInto(result);
+
+    uint32_t count = childCount(n);
+    for (uint32_t k = 0; k < count; k++)
+        collect(childSlots[n.childBase + k], result);
+}
+
+std::vector<uint32_t> AdaptiveTrie::searchPrefix(
     const std::string& prefix,
-    std::unordered_map<std::string, Book*>& bookMap
+    size_t limit
 ) {
-    TrieNode* curr = root;
+    int32_t curr = findPrefixNode(normalize(prefix));
+    if (curr < 0) return {};
 
-    for (char c : prefix) {
-        int i = idx(c);
-        if (i < 0 || !curr->children[i])
-            return {};
-        curr = curr->children[i];
+    if (limit > 0 && limit <= TOP_K) {
+        const uint32_t* top = &topPool[curr * TOP_K];
+        return std::vector<uint32_t>(top, top + std::min<size_t>(limit, nodes[curr].topCount));
+    }
+
+    std::vector<uint32_t> ids = subtreeDocs(curr);
+
+    std::sort(ids.begin(), ids.end(),
+        [this](uint32_t a, uint32_t b) { return ranksHigher(a, b); });
+
+    if (limit > 0 && ids.size() > limit)
+        ids.resize(limit);
+
+    return ids;
+}
+
+// A book can sit under several words of the subtree.
+std::vector<uint32_t> AdaptiveTrie::subtreeDocs(uint32_t node) {
+    std::vector<uint32_t> ids;
+    collect(node, ids);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+std::vector<uint32_t> AdaptiveTrie::prefixPostings(const std::string& prefix) {
+    int32_t curr = findPrefixNode(normalize(prefix));
+    if (curr < 0) return {};
+    return subtreeDocs(curr);
+}
+
+// row[j] is the edit distance between the path spelled so far and the first
+// j characters of key; each label character advances the automaton one step.
+void AdaptiveTrie::fuzzyWalk(
+    uint32_t node, const std::string& key, int maxEdits,
+    const std::vector<int>& row, std::vector<uint32_t>& result
+) {
+    const TrieNode& n = nodes[node];
+    uint32_t count = childCount(n);
+
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t child = childSlots[n.childBase + k];
+        const TrieNode& c = nodes[child];
+        std::vector<int> curr = row;
+        bool alive = true;
+
+        for (uint32_t l = 0; l < c.labelLength && alive; l++) {
+            char ch = labels[c.labelStart + l];
+            std::vector<int> next(key.size() + 1);
+            next[0] = curr[0] + 1;
+            int best = next[0];
+
+            for (size_t j = 1; j <= key.size(); j++) {
+                int cost = (key[j - 1] == ch) ? 0 : 1;
+                next[j] = std::min({ curr[j] + 1, next[j - 1] + 1, curr[j - 1] + cost });
+                best = std::min(best, next[j]);
+            }
+            curr.swap(next);
+
+            // The whole key is matched within budget: every word below
+            // extends an accepted prefix.
+            if (curr[key.size()] <= maxEdits) {
+                collect(child, result);
+                alive = false;
+                break;
+            }
+            if (best > maxEdits) alive = false;
+        }
+
+        if (alive)
+            fuzzyWalk(child, key, maxEdits, curr, result);
     }
+}
+
+std::vector<uint32_t> AdaptiveTrie::fuzzyPostings(const std::string& prefix, int maxEdits) {
+    std::string key = normalize(prefix);
+
+    // Short keys get a smaller budget, otherwise two edits on a three-letter
+    // prefix would match most of the catalog.
+    int budget = key.size() < 3 ? 0 : key.size() < 6 ? 1 : 2;
+    maxEdits = std::min(maxEdits, budget);
+    if (maxEdits <= 0)
+        return prefixPostings(prefix);
 
-    std::set<std::string> ids;
-    collect(curr, ids);
+    std::vector<int> row(key.size() + 1);
+    for (size_t j = 0; j <= key.size(); j++) row[j] = j;
 
-    std::vector<SearchResult> results;
-    for (auto& id : ids) {
-        auto it = bookMap.find(id);
-        if (it == bookMap.end()) continue;
+    std::vector<uint32_t> ids;
+    fuzzyWalk(0, key, maxEdits, row, ids);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+void AdaptiveTrie::updateBorrowImpact(const std::string& word, uint32_t docID) {
+    std::string key = normalize(word);
+    uint32_t curr = 0;
+    size_t i = 0;
 
-        Book* b = it->second;
-        SearchResult r;
-        r.bookID = id;
-        r.isbn = b->isbn;
-        r.title = b->title;
-        r.author = b->author;
-        r.category = b->category;
-        r.availableCopies = b->availableCopies;
-        r.totalCopies = b->totalCopies;
-        r.relevanceScore = b->borrowImpact;
+    offerTop(curr, docID);
 
-        results.push_back(r);
+    while (i < key.size()) {
+        int32_t child = findChild(curr, key[i] - 'a');
+        if (child < 0) return;
+        curr = child;
+        i += nodes[curr].labelLength;
+        offerTop(curr, docID);
     }
+}
+
+/* ================= SNAPSHOT ================= */
 
-    std::sort(results.begin(), results.end(),
-        [](const SearchResult& a, const SearchResult& b) {
-            return a.relevanceScore > b.relevanceScore;
-        });
+namespace {
+
+struct PostingSpan {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t count;
+    uint32_t lastID;
+};
+
+struct FreeBlock {
+    uint32_t size;
+    uint32_t base;
+};
 
-    return results;
 }
 
-void AdaptiveTrie::updateBorrowImpact(const std::string& word, double value) {
-    TrieNode* curr = root;
-    for (char c : word) {
-        int i = idx(c);
-        if (i < 0 || !curr->children[i])
-            return;
-        curr = curr->children[i];
+void AdaptiveTrie::writeTo(SnapshotWriter& out) const {
+    out.put<uint32_t>(sizeof(TrieNode));
+    out.put<uint32_t>(TOP_K);
+    out.putArray(nodes);
+    out.putString(labels);
+    out.putArray(childSlots);
+    out.putArray(topPool);
+
+    std::vector<FreeBlock> blocks;
+    for (size_t size = 0; size < freeBlocks.size(); size++)
+        for (uint32_t base : freeBlocks[size])
+            blocks.push_back({ static_cast<uint32_t>(size), base });
+    out.putArray(blocks);
+
+    std::vector<PostingSpan> spans;
+    std::vector<uint8_t> bytes;
+    for (const PostingList& list : postingLists) {
+        const auto& enc = list.encoded();
+        spans.push_back({ static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(enc.size()),
+                          static_cast<uint32_t>(list.size()), list.last() });
+        bytes.insert(bytes.end(), enc.begin(), enc.end());
+    }
+    out.putArray(spans);
+    out.putArray(bytes);
+}
+
+void AdaptiveTrie::readFrom(SnapshotCursor in) {
+    if (in.get<uint32_t>() != sizeof(TrieNode) || in.get<uint32_t>() != TOP_K)
+        throw std::runtime_error("Snapshot trie layout mismatch");
+
+    in.getArray(nodes);
+    labels = in.getString();
+    in.getArray(childSlots);
+    in.getArray(topPool);
+    if (nodes.empty() || topPool.size() != nodes.size() * TOP_K)
+        throw std::runtime_error("Snapshot trie is inconsistent");
+
+    size_t n;
+    const FreeBlock* blocks = in.array<FreeBlock>(n);
+    freeBlocks.clear();
+    for (size_t k = 0; k < n; k++) {
+        // A child block holds at most one slot per letter.
+        if (blocks[k].size == 0 || blocks[k].size > 26 ||
+            blocks[k].base > childSlots.size() - blocks[k].size)
+            throw std::runtime_error("Snapshot trie is inconsistent");
+        if (freeBlocks.size() <= blocks[k].size) freeBlocks.resize(blocks[k].size + 1);
+        freeBlocks[blocks[k].size].push_back(blocks[k].base);
+    }
+
+    size_t spanCount, byteCount;
+    const PostingSpan* spans = in.array<PostingSpan>(spanCount);
+    const uint8_t* bytes = in.array<uint8_t>(byteCount);
+
+    // Every index the search paths follow without checking: label slices,
+    // child blocks and the children in them, posting lists and top-K doc IDs.
+    for (size_t k = 0; k < nodes.size(); k++) {
+        const TrieNode& node = nodes[k];
+        uint32_t count = childCount(node);
+        bool valid = node.labelStart <= labels.size() &&
+                     node.labelLength <= labels.size() - node.labelStart &&
+                     node.childMask < (1u << 26) &&
+                     node.childBase <= childSlots.size() &&
+                     count <= childSlots.size() - node.childBase &&
+                     node.postings >= -1 &&
+                     (node.postings < 0 || static_cast<size_t>(node.postings) < spanCount) &&
+                     node.topCount <= TOP_K;
+        for (uint32_t c = 0; valid && c < count; c++)
+            valid = childSlots[node.childBase + c] != 0 &&
+                    childSlots[node.childBase + c] < nodes.size();
+        for (uint32_t t = 0; valid && t < node.topCount; t++)
+            valid = topPool[k * TOP_K + t] < docs.size();
+        if (!valid)
+            throw std::runtime_error("Snapshot trie is inconsistent");
+    }
+
+    postingLists.assign(spanCount, PostingList());
+    for (size_t k = 0; k < spanCount; k++) {
+        if (spans[k].offset > byteCount || spans[k].length > byteCount - spans[k].offset ||
+            (spans[k].count > 0 && spans[k].lastID >= docs.size()))
+            throw std::runtime_error("Snapshot trie is inconsistent");
+        postingLists[k].assignEncoded(bytes + spans[k].offset, spans[k].length,
+                                      spans[k].count, spans[k].lastID);
     }
-    curr->borrowImpact += value;
 }
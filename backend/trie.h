@@ -2,43 +2,109 @@
 #define TRIE_H
 
 #include "models.h"
-#include <unordered_map>
+#include "posting_list.h"
+#include "snapshot.h"
 #include <vector>
-#include <set>
+#include <cstdint>
 
+/*
+ * Path-compressed (radix) trie node. Nodes live in AdaptiveTrie's arena and
+ * refer to each other by index, so the whole structure is a few flat vectors.
+ *
+ * - The edge label leading into the node is a slice of the shared label pool.
+ * - Children are encoded as a 26-bit mask plus a block in the child-slot pool;
+ *   the child for letter c sits at popcount(mask & ((1 << c) - 1)).
+ * - The ranked top-K list lives in a fixed block of the top pool.
+ *
+ * Nodes are plain data, so the arena can be copied in and out of a snapshot
+ * wholesale.
+ */
 struct TrieNode {
-    TrieNode* children[26];
-    bool isEnd;
-    long long frequency;
-    long long borrowImpact;
-    std::set<std::string> bookIDs;
-
-    TrieNode() : isEnd(false), frequency(0), borrowImpact(0) {
-        for (int i = 0; i < 26; i++)
-            children[i] = nullptr;
-    }
+    uint32_t labelStart;
+    uint32_t labelLength;
+    uint32_t childMask;
+    uint32_t childBase;
+    int32_t postings;       // index into AdaptiveTrie::postingLists, -1 if not a word end
+
+    // Number of doc IDs in this node's top-pool block: the best-ranked books
+    // in its subtree, best first, at most AdaptiveTrie::TOP_K.
+    uint32_t topCount;
+
+    TrieNode(uint32_t start, uint32_t length)
+        : labelStart(start), labelLength(length),
+          childMask(0), childBase(0), postings(-1), topCount(0) {}
 };
 
 class AdaptiveTrie {
 private:
-    TrieNode* root;
+    std::vector<TrieNode> nodes;                // nodes[0] is the root
+    std::string labels;
+    std::vector<uint32_t> childSlots;
+    std::vector<std::vector<uint32_t>> freeBlocks;  // freed child blocks, by size
+    std::vector<PostingList> postingLists;
+    std::vector<uint32_t> topPool;              // TOP_K slots per node
+
+    // Dense docID -> Book* table owned by LibraryEngine.
+    const std::vector<Book*>& docs;
 
-    void collect(TrieNode* node, std::set<std::string>& result);
-    void deleteNode(TrieNode* node);
     int idx(char c);
+    std::string normalize(const std::string& word);
+
+    uint32_t childCount(const TrieNode& node) const;
+    int32_t findChild(uint32_t node, int letter) const;
+    void addChild(uint32_t node, int letter, uint32_t child);
+    void replaceChild(uint32_t node, int letter, uint32_t child);
+    uint32_t allocBlock(uint32_t size);
+    uint32_t newNode(uint32_t labelStart, uint32_t labelLength);
+    uint32_t splitNode(uint32_t parent, uint32_t child, uint32_t at);
+    int32_t findPrefixNode(const std::string& key);
+
+    void collect(uint32_t node, std::vector<uint32_t>& result);
+    std::vector<uint32_t> subtreeDocs(uint32_t node);
+    void fuzzyWalk(uint32_t node, const std::string& key, int maxEdits,
+                   const std::vector<int>& row, std::vector<uint32_t>& result);
+    bool ranksHigher(uint32_t a, uint32_t b) const;
+    void offerTop(uint32_t node, uint32_t docID);
+    void rebuildTop(uint32_t node);
 
 public:
-    AdaptiveTrie();
+    static constexpr size_t TOP_K = 10;
+
+    explicit AdaptiveTrie(const std::vector<Book*>& docTable);
     ~AdaptiveTrie();
 
-    void insert(const std::string& word, const std::string& bookID);
+    void insert(const std::string& word, uint32_t docID);
+
+    // Drops docID from the word's posting list and re-ranks the path.
+    // Emptied nodes stay in the arena and are reused by later inserts.
+    void remove(const std::string& word, uint32_t docID);
 
-    std::vector<SearchResult> searchPrefix(
+    // Doc IDs of words starting with prefix, best ranked first.
+    // limit == 0 returns every match; 0 < limit <= TOP_K is answered
+    // straight from the prefix node's ranked list without walking the subtree.
+    std::vector<uint32_t> searchPrefix(
         const std::string& prefix,
-        std::unordered_map<std::string, Book*>& bookMap
+        size_t limit = 0
     );
 
-    void updateBorrowImpact(const std::string& word, double value);
+    // Sorted, de-duplicated doc IDs of every word starting with prefix.
+    // Non-letters in prefix are ignored, as they are on insert.
+    std::vector<uint32_t> prefixPostings(const std::string& prefix);
+
+    // Like prefixPostings, but a word matches when some prefix of it is
+    // within maxEdits (Levenshtein) of the query. The trie is walked in
+    // lockstep with the edit-distance automaton, so branches that can no
+    // longer match are pruned inside the index. Keys shorter than 3 letters
+    // allow no edits and keys shorter than 6 allow at most one.
+    std::vector<uint32_t> fuzzyPostings(const std::string& prefix, int maxEdits);
+
+    // Re-rank a book along the word's path after its borrowImpact grew.
+    void updateBorrowImpact(const std::string& word, uint32_t docID);
+
+    // Arena, posting lists and top-K blocks are copied out and back in
+    // wholesale; readFrom replaces the current contents.
+    void writeTo(SnapshotWriter& out) const;
+    void readFrom(SnapshotCursor in);
 };
 
 #endif
@@ -188,7 +188,11 @@ def api_search():
     return jsonify(send_to_backend({
         "action": "search",
         "query": data.get("query"),
-        "type": data.get("type", "title")
+        "type": data.get("type", "title"),
+        "limit": data.get("limit", 0),
+        "fuzzy": data.get("fuzzy", 0),
+        "engine": data.get("engine", "trie"),
+        "cursor": data.get("cursor", "")
     }))
 
 @app.route('/api/issue', methods=['POST'])